@@ -1,235 +1,1333 @@
 #include "analyzer.h"
+#include "async_reader.h"
+#include "checkpoint.h"
+#include "compressed_input.h"
+#include "csv_scan.h"
+#include "decimal.h"
+#include "mapped_file.h"
+#include "snapshot.h"
+#include "timestamp.h"
+#include "top_k.h"
+#include "work_pool.h"
 #include <fstream>
 #include <iostream>
 #include <algorithm>
 #include <string_view>
 #include <vector>
-#include <charconv>
-#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRIP_HAVE_POSIX_IO
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
+// Same set as isspace in the "C" locale, without the locale table lookup
+static inline bool isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
 // Trims whitespaces
 static string_view trim(string_view s) 
 {
     size_t start = 0;
-    while (start < s.size() && 
-        isspace(static_cast<unsigned char>
-                (s[start])))
+    while (start < s.size() && isSpace(s[start]))
         start++;
 
     size_t end = s.size();
-    while (end > start && 
-        isspace(static_cast<unsigned char>
-                (s[end - 1])))
+    while (end > start && isSpace(s[end - 1]))
         end--;
 
     return s.substr(start, end - start);
 }
 
-// Extracts Hour
-static int extractHour(string_view str)
+// Optional aggregates the options ask for
+static TableFeatures tableFeatures(const AnalyzerOptions& opts)
 {
-    str = trim(str);
-    if (str.empty())
-        return -1;
+    TableFeatures features;
+    features.days = opts.trackDays;
+    features.minutes = opts.trackMinutes;
+    features.amounts = opts.trackAmounts;
+    features.routes = opts.trackRoutes;
+    features.weekdays = opts.trackWeekdays;
+    features.quarterHours = opts.trackQuarterHours;
+    features.fiveMinutes = opts.trackFiveMinutes;
+    features.heavyHitters = opts.heavyHitterCapacity;
+    CountMinSketch::dimensions(opts.sketchEpsilon, opts.sketchDelta,
+                               features.sketchWidth, features.sketchDepth);
+    return features;
+}
 
-    size_t colon = str.find(':');
-    if (colon == string_view::npos || colon == 0)
-        return -1;
+TripAnalyzer::TripAnalyzer(const AnalyzerOptions& opts)
+    : options(opts), tables(tableFeatures(opts))
+{
+}
 
-    size_t hourEnd = colon;
-    size_t hourStart = colon - 1;
+void TripAnalyzer::ingestFields(const char* rowBegin, size_t length,
+                                const size_t* commas, int commaCount,
+                                ZoneStatsTable& out, TripIdFilter* tripIds)
+{
+    if (length == 0)
+        return;
 
-    if (hourStart > 0 && 
-            isdigit(static_cast<unsigned char>
-                    (str[hourStart - 1])))
-        hourStart--;
+    // Structure: TripID, PickupZoneID, DropoffZoneID, PickupDateTime,
+    // DistanceKm, FareAmount -> at least five commas
+    // DistanceKm and FareAmount are structure checks only, unless
+    // trackAmounts reads them
+    if (commaCount < kTrackedCommas)
+        return;
 
-    int hour = 0;
-    auto res = std::from_chars(str.data() + 
-        hourStart, str.data() + hourEnd, hour);
+    string_view row(rowBegin, length);
+    size_t c1 = commas[0], c2 = commas[1], c3 = commas[2], c4 = commas[3];
 
-    if (res.ec != std::errc())
-        return -1;
+    string_view tripId = trim(row.substr(0, c1));
+    // Dirty Data Rule 1: Empty TripID
+    if (tripId.empty())
+        return;
 
-    if (hour < 0 || hour > 23)
-        return -1;
+    string_view zoneId = trim(row.substr(c1 + 1, c2 - c1 - 1));
+    // Dirty Data Rule 2: Empty Zone
+    if (zoneId.empty())
+        return;
+
+    // DropoffZoneID (Skip content, structure checked by the comma count,
+    // unless trackRoutes reads it)
+
+    string_view timeView = row.substr(c3 + 1, c4 - c3 - 1);
+    // Dirty Data Rule 3: Invalid Timestamp
+    Timestamp pickup;
+    if (!parseTimestamp(timeView, pickup))
+        return;
+
+    // Replayed row, its first copy is already counted
+    if (tripIds && tripIds->seen(tripId))
+        return;
+
+    // --- Data Aggregation ---
+
+    if (out.sketches())
+        out.addSketch(zoneId, pickup.hour);
+
+    // Bounded-memory mode, only the two summaries are kept
+    if (out.approximate())
+    {
+        out.addApprox(zoneId, pickup.hour);
+        return;
+    }
+
+    // Interning looks the view up directly, no key copy per row
+    uint32_t id = out.add(zoneId, pickup.hour);
+
+    // Time series only when asked for, the id saves a second lookup
+    if (out.tracksTime())
+        out.addTime(id, epochMinutes(pickup));
+
+    // An empty dropoff still counts as a trip, just not as a route
+    if (out.tracksRoutes())
+    {
+        string_view dropoff = trim(row.substr(c2 + 1, c3 - c2 - 1));
+        if (!dropoff.empty())
+            out.addRoute(id, dropoff);
+    }
+
+    // A malformed distance or fare still counts as a trip, so the counts
+    // don't depend on the option, but adds nothing to the amounts
+    if (out.tracksAmounts())
+    {
+        size_t c5 = commas[4];
+        const char* fareBegin = rowBegin + c5 + 1;
+        const char* fareEnd = static_cast<const char*>(memchr(fareBegin, ',', length - c5 - 1));
+        if (!fareEnd)
+            fareEnd = rowBegin + length;
+
+        long long distance = 0, fare = 0;
+        if (parseDecimalField(rowBegin, rowBegin + c4 + 1, rowBegin + c5, distance) &&
+            parseDecimalField(rowBegin, fareBegin, fareEnd, fare))
+            out.addAmounts(id, pickup.hour, distance, fare);
+        else
+            out.rejectAmounts();
+    }
+}
+
+void TripAnalyzer::ingestRange(const char* begin, const char* end, ZoneStatsTable& out,
+                               TripIdFilter* tripIds)
+{
+    // SIMD block scan finds every ',' and '\n', rows arrive pre-split
+    scanRows(begin, end, [&out, tripIds](const char* row, size_t length,
+                                         const size_t* commas, int commaCount) {
+        ingestFields(row, length, commas, commaCount, out, tripIds);
+    });
+}
+
+unsigned TripAnalyzer::workerThreads() const
+{
+    if (options.threads == 0)
+        return max(1u, thread::hardware_concurrency());
+
+    return options.threads;
+}
+
+size_t TripAnalyzer::chunkCount(size_t length) const
+{
+    // Which copy of a TripID comes first depends on the row order
+    if (options.dedupeTripIds)
+        return 1;
+
+    // Don't spin up workers for less than minChunkBytes each
+    size_t chunkFloor = max<size_t>(1, options.minChunkBytes);
+    size_t maxChunks = max<size_t>(1, length / chunkFloor);
+    return min<size_t>(workerThreads(), maxChunks);
+}
+
+void TripAnalyzer::ingestBuffer(const char* data, size_t length)
+{
+    size_t chunks = chunkCount(length);
+    if (chunks <= 1)
+    {
+        ingestRange(data, data + length, tables, tripIdFilter());
+        return;
+    }
+
+    // Private tables per worker, no locking on the hot path
+    vector<ZoneStatsTable> workerTables(chunks, ZoneStatsTable(tables.features()));
+    ingestChunks(data, length, workerTables);
+
+    // Merge: counts are plain sums so the order doesn't matter
+    for (const ZoneStatsTable& part : workerTables)
+        tables.merge(part);
+}
+
+void TripAnalyzer::ingestChunks(const char* data, size_t length, vector<ZoneStatsTable>& parts)
+{
+    size_t chunks = parts.size();
+
+    // Chunk i covers [bounds[i], bounds[i + 1])
+    // Every bound sits right after a '\n', so no row is ever split,
+    // the header stays in chunk 0 and is rejected there as usual
+    vector<const char*> bounds;
+    bounds.reserve(chunks + 1);
+    bounds.push_back(data);
+
+    const char* end = data + length;
+    for (size_t i = 1; i < chunks; ++i)
+    {
+        const char* nominal = data + (length / chunks) * i;
+        if (nominal < bounds.back())
+            nominal = bounds.back();
+
+        const char* nl = static_cast<const char*>(memchr(nominal, '\n', end - nominal));
+        if (!nl)
+            break;
+
+        bounds.push_back(nl + 1);
+    }
+    bounds.push_back(end);
+
+    // The calling thread takes the first chunk
+    size_t workerCount = bounds.size() - 1;
+    vector<thread> workers;
+    workers.reserve(workerCount - 1);
+    for (size_t i = 1; i < workerCount; ++i)
+    {
+        workers.emplace_back([&, i]() {
+            ingestRange(bounds[i], bounds[i + 1], parts[i]);
+        });
+    }
+
+    ingestRange(bounds[0], bounds[1], parts[0]);
+
+    for (auto& w : workers)
+        w.join();
+}
+
+bool TripAnalyzer::ingestMapped(const string& csvPath)
+{
+    MappedFile file;
+    if (!file.open(csvPath))
+        return false;
+
+    // Compressed archives are decoded on background threads while the
+    // rows decoded so far are parsed here
+    InputCodec codec = detectCodec(file.data(), file.size());
+    if (codec != InputCodec::Plain)
+    {
+        DecodedStream decoded(file.data(), file.size(), codec,
+                              workerThreads(), options.readBlockBytes);
+
+        ingestBlocks([&decoded](char* dst, size_t capacity) {
+            return decoded.read(dst, capacity);
+        });
+
+        // The rows before the damage stay counted
+        if (!decoded.ok())
+            damagedInputs++;
+        return true;
+    }
+
+    if (!options.useMmap)
+        return false;
+
+    // Rows are hardly ever shorter than 32 bytes, so one filter size fits
+    if (options.dedupeTripIds)
+        tripIds.reserve(tripIds.size() + file.size() / 32);
+
+    if (!options.checkpointPath.empty() && checkpointable())
+    {
+        ingestCheckpointed(csvPath, file.data(), file.size());
+        skippedCheckpoint = false;
+    }
+    else
+        ingestBuffer(file.data(), file.size());
+    return true;
+}
+
+bool TripAnalyzer::checkpointable() const
+{
+    // The image holds the totals and hour counts only, the Space-Saving
+    // summaries and the track* tables would lose every row before the
+    // offset on resume, and without the TripIDs seen a replay of those
+    // rows would be counted again
+    const TableFeatures& f = tables.features();
+    return !tables.approximate() && !options.dedupeTripIds && !f.days && !f.minutes && !f.amounts &&
+           !f.routes && !f.weekdays && !f.quarterHours && !f.fiveMinutes;
+}
+
+void TripAnalyzer::ingestCheckpointed(const string& csvPath, const char* data, size_t length)
+{
+    CheckpointSource source;
+    if (!checkpointSource(csvPath, source) || source.size != length)
+    {
+        ingestBuffer(data, length);
+        return;
+    }
+
+    // The checkpoint holds the whole aggregate state at that offset,
+    // so it replaces what is here rather than adding to it
+    size_t start = 0;
+    uint64_t offset = 0;
+    ZoneStatsTable resumed;
+    if (readCheckpointFile(options.checkpointPath, source, offset, resumed))
+    {
+        tables = move(resumed);
+        tables.enable(tableFeatures(options));
+        start = static_cast<size_t>(offset);
+    }
+
+    size_t every = max<size_t>(1, options.checkpointEveryBytes);
+    while (start < length)
+    {
+        // Steps end right after a '\n' so the offset never splits a row
+        size_t stop = length;
+        if (length - start > every)
+        {
+            const char* cut = data + start + every - 1;
+            const char* nl = static_cast<const char*>(memchr(cut, '\n', data + length - cut));
+            if (nl)
+                stop = static_cast<size_t>(nl + 1 - data);
+        }
+
+        ingestBuffer(data + start, stop - start);
+        start = stop;
+
+        // A failed write only costs progress, the previous checkpoint stays
+        if (start < length)
+            writeCheckpointFile(options.checkpointPath, source, start, tables);
+    }
+
+    remove(options.checkpointPath.c_str());
+}
+
+bool TripAnalyzer::ingestAsync(const string& csvPath)
+{
+    AsyncFileReader reader;
+    AsyncFileReader::Backend backend = options.useIoUring ? AsyncFileReader::Backend::Auto
+                                                          : AsyncFileReader::Backend::Pread;
+    if (!reader.open(csvPath, options.readBlockBytes, options.ioQueueDepth, backend))
+        return false;
+
+    const char* block = nullptr;
+    size_t length = 0;
+    if (!reader.next(block, length))
+        return false;
+
+    // Archives are left to the mapped path, which decodes them
+    if (detectCodec(block, length) != InputCodec::Plain)
+        return false;
+
+    // A block only lives until the next read, so it is split between the
+    // workers on its own. Their tables last the whole file and are merged
+    // once at the end, not per block
+    size_t chunks = chunkCount(reader.size());
+    vector<ZoneStatsTable> workerTables;
+    if (chunks > 1)
+        workerTables.assign(chunks, ZoneStatsTable(tables.features()));
+
+    // Rows split across two blocks are stitched together here,
+    // whole rows are parsed straight out of the read buffers
+    string carry;
+    do
+    {
+        const char* p = block;
+        const char* end = block + length;
+
+        if (!carry.empty())
+        {
+            const char* nl = static_cast<const char*>(memchr(p, '\n', length));
+            if (!nl)
+            {
+                carry.append(p, length);
+                continue;
+            }
+
+            carry.append(p, nl + 1);
+            ingestRange(carry.data(), carry.data() + carry.size(), tables, tripIdFilter());
+            carry.clear();
+            p = nl + 1;
+        }
+
+        const char* lastNl = end;
+        while (lastNl > p && lastNl[-1] != '\n')
+            --lastNl;
 
-    return hour;
+        if (lastNl > p && workerTables.empty())
+            ingestRange(p, lastNl, tables, tripIdFilter());
+        else if (lastNl > p)
+            ingestChunks(p, static_cast<size_t>(lastNl - p), workerTables);
+
+        carry.append(lastNl, end);
+    } while (reader.next(block, length));
+
+    // Last row without a trailing newline, same as getline
+    if (!carry.empty())
+        ingestRange(carry.data(), carry.data() + carry.size(), tables, tripIdFilter());
+
+    for (const ZoneStatsTable& part : workerTables)
+        tables.merge(part);
+
+    lastIo = reader.stats();
+    return true;
+}
+
+template <class ReadFn>
+void TripAnalyzer::ingestBlocks(ReadFn&& read)
+{
+    size_t blockBytes = max<size_t>(64, options.readBlockBytes);
+    vector<char> buffer(blockBytes);
+    size_t carry = 0;
+
+    for (;;)
+    {
+        // A single row longer than the buffer: grow until it fits
+        if (carry == buffer.size())
+            buffer.resize(buffer.size() * 2);
+
+        size_t got = read(buffer.data() + carry, buffer.size() - carry);
+        if (got == 0)
+            break;
+
+        size_t filled = carry + got;
+
+        // Parse up to the last complete row, keep the rest for next time
+        // Backward scan only walks the partial row, not the whole block
+        const char* lastNl = buffer.data() + filled;
+        while (lastNl > buffer.data() && lastNl[-1] != '\n')
+            --lastNl;
+
+        if (lastNl == buffer.data())
+        {
+            carry = filled;
+            continue;
+        }
+
+        size_t complete = static_cast<size_t>(lastNl - buffer.data());
+        ingestRange(buffer.data(), buffer.data() + complete, tables, tripIdFilter());
+
+        carry = filled - complete;
+        memmove(buffer.data(), buffer.data() + complete, carry);
+    }
+
+    // Last row without a trailing newline, same as getline
+    if (carry > 0)
+        ingestRange(buffer.data(), buffer.data() + carry, tables, tripIdFilter());
+}
+
+void TripAnalyzer::ingestStream(istream& in)
+{
+    streambuf* source = in.rdbuf();
+    if (!source)
+        return;
+
+    ingestBlocks([source](char* dst, size_t capacity) -> size_t {
+        streamsize got = source->sgetn(dst, static_cast<streamsize>(capacity));
+        return got > 0 ? static_cast<size_t>(got) : 0;
+    });
+
+    aggregatesChanged();
+}
+
+void TripAnalyzer::ingestFd(int fd)
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    if (fd < 0)
+        return;
+
+    ingestBlocks([fd](char* dst, size_t capacity) -> size_t {
+        for (;;)
+        {
+            ssize_t got = read(fd, dst, capacity);
+            if (got >= 0)
+                return static_cast<size_t>(got);
+
+            // Interrupted reads are retried, any other error ends the input
+            if (errno != EINTR)
+                return 0;
+        }
+    });
+
+    aggregatesChanged();
+#else
+    (void)fd;
+#endif
 }
 
 void TripAnalyzer::ingestFile(const string& csvPath) 
 {
-    // Reserve memory to prevent rehashings
-    zoneCountMap.reserve(150000);
-    slotCountMap.reserve(150000);
+    // Reserve memory to prevent rehashings, the approximate mode keeps
+    // no records and its memory is set by heavyHitterCapacity alone
+    if (!tables.approximate())
+        tables.reserve(150000);
+
+    // Cleared by the one path that checkpoints
+    skippedCheckpoint = !options.checkpointPath.empty();
+
+    if (options.asyncIo && ingestAsync(csvPath))
+    {
+        aggregatesChanged();
+        return;
+    }
+
+    if (ingestMapped(csvPath))
+    {
+        aggregatesChanged();
+        return;
+    }
 
-    // Large IO Buffer (64KB) for uninterrupted reads as possible for optimization
-    char buffer[65536];
+    // Pipes, /proc entries, or mmap turned off
+#ifdef TRIP_HAVE_POSIX_IO
+    int fd = open(csvPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
 
-    ifstream inFile(csvPath);
+    ingestFd(fd);
+    close(fd);
+#else
+    ifstream inFile(csvPath, ios::binary);
     if (!inFile.is_open())
         return;
 
-    inFile.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
+    ingestStream(inFile);
+#endif
+}
+
+void TripAnalyzer::ingestFiles(const vector<string>& paths)
+{
+    // One filter sees every row, in the order of paths
+    if (options.dedupeTripIds)
+    {
+        for (const string& path : paths)
+            ingestFile(path);
+        return;
+    }
+
+    unsigned threads = workerThreads();
+    WorkStealingPool pool(threads);
 
-    string line;
-    line.reserve(128);
-    string keyBuffer;
-    keyBuffer.reserve(64);
+    // One private table per worker, merged once at the end
+    vector<ZoneStatsTable> workerTables(pool.size(), ZoneStatsTable(tables.features()));
+    vector<long long> workerDamaged(pool.size(), 0);
 
-    while (getline(inFile, line)) 
+    // Files that can't be split go through the regular single-file path
+    // Workers share one checkpointPath, so no file is checkpointed here
+    skippedCheckpoint = !options.checkpointPath.empty();
+    AnalyzerOptions single = options;
+    single.threads = 1;
+    single.cacheResults = false;
+    single.checkpointPath.clear();
+
+    bool splitPlain = options.useMmap && !options.asyncIo;
+    size_t chunkBytes = max<size_t>(1, options.minChunkBytes);
+
+    for (const string& path : paths)
     {
-        if (line.empty())
-            continue;
+        pool.push([&, path](unsigned worker) {
+            auto file = make_shared<MappedFile>();
+            if (splitPlain && file->open(path) &&
+                detectCodec(file->data(), file->size()) == InputCodec::Plain)
+            {
+                // Queue every chunk but the last, idle workers steal them
+                // Chunks end right after a '\n' like in ingestBuffer
+                const char* begin = file->data();
+                const char* end = begin + file->size();
 
-        string_view row(line);
-        
-        // TripID
-        size_t c1 = row.find(',');
-        if (c1 == string_view::npos)
-            continue;
+                while (static_cast<size_t>(end - begin) > chunkBytes)
+                {
+                    const char* cut = begin + chunkBytes - 1;
+                    const char* nl = static_cast<const char*>(memchr(cut, '\n', end - cut));
+                    if (!nl || nl + 1 == end)
+                        break;
 
-        string_view tripId = trim(row.substr(0, c1));
-        // Dirty Data Rule 1: Empty TripID
-        if (tripId.empty())
-            continue;
+                    const char* stop = nl + 1;
+                    pool.spawn(worker, [file, begin, stop, &workerTables](unsigned w) {
+                        ingestRange(begin, stop, workerTables[w]);
+                    });
+                    begin = stop;
+                }
 
-        // PickupZoneID
-        size_t c2 = row.find(',', c1 + 1);
-        if (c2 == string_view::npos)
-            continue;
+                ingestRange(begin, end, workerTables[worker]);
+                return;
+            }
 
-        string_view zoneId = trim(row.substr(c1 + 1, c2 - c1 - 1));
-        // Dirty Data Rule 2: Empty Zone
-        if (zoneId.empty())
-            continue;
+            TripAnalyzer one(single);
+            one.ingestFile(path);
+            workerTables[worker].merge(one.tables);
+            workerDamaged[worker] += one.decodeErrors();
+        });
+    }
 
-        // DropoffZoneID (Skip content, but check structure)
-        size_t c3 = row.find(',', c2 + 1);
-        if (c3 == string_view::npos)
-            continue;
+    pool.run();
 
-        // PickupDateTime
-        size_t c4 = row.find(',', c3 + 1);
-        if (c4 == string_view::npos)
-            continue;
+    for (long long damaged : workerDamaged)
+        damagedInputs += damaged;
+
+    // Counts are plain sums, so the result doesn't depend on who ran what
+    for (const ZoneStatsTable& part : workerTables)
+        tables.merge(part);
 
-        string_view timeView = row.substr(c3 + 1, c4 - c3 - 1);
-        // Dirty Data Rule 3: Invalid Timestamp
-        int hour = extractHour(timeView);
-        if (hour == -1)
-            continue; 
+    aggregatesChanged();
+}
+
+bool TripAnalyzer::follow(const string& csvPath)
+{
+    auto file = make_unique<FileFollower>();
+    if (!file->open(csvPath, options.readBlockBytes))
+        return false;
+
+    following.file = move(file);
+    pollFollow(0);
+    return true;
+}
+
+size_t TripAnalyzer::pollFollow(int timeoutMs)
+{
+    if (!following.file)
+        return 0;
 
-        // 5. DistanceKm (Check structure ONLY)
-        // We assume if c5 found, the row is structurally valid
-        size_t c5 = row.find(',', c4 + 1);
-        if (c5 == string_view::npos)
+    following.file->wait(timeoutMs);
+
+    // The first poll may catch up on a large backlog, split it like a file
+    size_t consumed = following.file->readNew([this](const char* begin, const char* end) {
+        ingestBuffer(begin, static_cast<size_t>(end - begin));
+    });
+
+    if (consumed > 0)
+        aggregatesChanged();
+    return consumed;
+}
+
+void TripAnalyzer::stopFollowing()
+{
+    following.file.reset();
+}
+
+uint64_t TripAnalyzer::followOffset() const
+{
+    return following.file ? following.file->offset() : 0;
+}
+
+// '*' matches any run of characters, '?' any single one
+static bool matchesPattern(const char* name, const char* pattern)
+{
+    const char* starPattern = nullptr;
+    const char* starName = nullptr;
+
+    while (*name)
+    {
+        if (*pattern == '*')
+        {
+            starPattern = ++pattern;
+            starName = name;
+        }
+        else if (*pattern == '?' || *pattern == *name)
+        {
+            ++pattern;
+            ++name;
+        }
+        else if (starPattern)
+        {
+            // Let the last '*' swallow one more character
+            pattern = starPattern;
+            name = ++starName;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (*pattern == '*')
+        ++pattern;
+    return *pattern == '\0';
+}
+
+size_t TripAnalyzer::ingestDirectory(const string& directory, const string& pattern)
+{
+    namespace fs = std::filesystem;
+
+    // error_code overloads: an unreadable directory just yields no files
+    vector<string> paths;
+    error_code ec;
+    for (fs::directory_iterator it(directory, ec), last; !ec && it != last; it.increment(ec))
+    {
+        error_code typeEc;
+        if (!it->is_regular_file(typeEc))
             continue;
 
-        // 6. FareAmount
-        // We implicitly checked the structure because we found c5.
+        string name = it->path().filename().string();
+        if (matchesPattern(name.c_str(), pattern.c_str()))
+            paths.push_back(it->path().string());
+    }
+
+    // Directory order is arbitrary, keep runs reproducible
+    sort(paths.begin(), paths.end());
+
+    ingestFiles(paths);
+    return paths.size();
+}
+
+bool TripAnalyzer::saveSnapshot(const string& path) const
+{
+    // The image holds exact records, the summaries would be lost
+    if (tables.approximate())
+        return false;
+
+    return writeSnapshotFile(path, tables);
+}
 
-        // --- Data Aggregation ---
+bool TripAnalyzer::loadSnapshot(const string& path)
+{
+    // Loaded records would never reach the summaries the rankings read
+    if (tables.approximate() || !readSnapshotFile(path, tables))
+        return false;
 
-        // Assign string_view to buffer to avoid malloc
-        keyBuffer.assign(zoneId); 
-        
-        zoneCountMap[keyBuffer]++;
+    tables.enable(tableFeatures(options));
 
-        vector<long long>& hours = slotCountMap[keyBuffer];
-        if (hours.empty())
-            hours.resize(24, 0);
+    aggregatesChanged();
+    return true;
+}
 
-        hours[hour]++;
+bool TripAnalyzer::merge(const TripAnalyzer& other)
+{
+    if (tables.approximate() != other.tables.approximate())
+        return false;
+
+    tables.merge(other.tables);
+    aggregatesChanged();
+    return true;
+}
+
+bool TripAnalyzer::merge(TripAnalyzer&& other)
+{
+    // Exact records and Space-Saving summaries don't combine
+    if (tables.approximate() != other.tables.approximate())
+        return false;
+
+    if (&other == this)
+    {
+        tables.merge(tables);
     }
+    else
+    {
+        // Sums commute, so fold the smaller table into the larger one
+        if (other.tables.size() > tables.size())
+            swap(tables, other.tables);
+
+        tables.merge(other.tables);
+        tables.enable(tableFeatures(options));
+        other.tables = ZoneStatsTable(tableFeatures(other.options));
+        other.aggregatesChanged();
+    }
+
+    aggregatesChanged();
+    return true;
+}
+
+string TripAnalyzer::exportAggregates() const
+{
+    if (tables.approximate())
+        return {};
+
+    return encodeSnapshot(tables);
+}
+
+bool TripAnalyzer::mergeAggregates(const string& bytes)
+{
+    ZoneStatsTable part;
+    if (tables.approximate() || !decodeSnapshot(bytes.data(), bytes.size(), part))
+        return false;
+
+    tables.merge(part);
+    aggregatesChanged();
+    return true;
 }
 
 std::vector<ZoneCount> TripAnalyzer::topZones(int k) const 
 {
-    vector<ZoneCount> results;
-    
-    // Reserve upfront to avoid reallocations during push_back
-    results.reserve(zoneCountMap.size());
-    
-    // Flatten unordered_map -> vector
-    for (const auto& [zone, count] : zoneCountMap)
-        results.push_back({ zone, count });
-
-    if (k < 0 || results.empty())
+    if (k <= 0 || tables.empty())
         return {};
 
-    size_t topK = min(static_cast<size_t>(k), 
-                      results.size());
-    
-    // PARTIAL SORT:
-    // - Ensures the first topK elements are the "best" ones
-    // - Complexity: O(N log K), faster than full sort when K << N
-    // - Elements beyond topK are left in unspecified order
-    partial_sort(results.begin(), 
-                 results.begin() + topK,
-                 results.end(),
-                 [](const ZoneCount& a, const ZoneCount& b) {
-        
-        // Primary sort key: total trip count (descending)
+    if (!options.cacheResults)
+        return rankZones(static_cast<size_t>(k));
+
+    lock_guard<mutex> guard(cache.lock);
+    auto& entry = cache.zones;
+    size_t want = static_cast<size_t>(k);
+
+    if (entry.covers(generation, want))
+    {
+        cache.stats.zoneHits++;
+    }
+    else
+    {
+        cache.stats.zoneMisses++;
+        entry.rows = rankZones(want);
+        entry.depth = want;
+        entry.generation = generation;
+        entry.valid = true;
+    }
+
+    // Repeated queries only copy the K cached rows
+    size_t n = min(want, entry.rows.size());
+    return vector<ZoneCount>(entry.rows.begin(), entry.rows.begin() + n);
+}
+
+std::vector<SlotCount> TripAnalyzer::topBusySlots(int k) const 
+{
+    if (k <= 0 || tables.empty())
+        return {};
+
+    if (!options.cacheResults)
+        return rankSlots(static_cast<size_t>(k));
+
+    lock_guard<mutex> guard(cache.lock);
+    auto& entry = cache.slots;
+    size_t want = static_cast<size_t>(k);
+
+    if (entry.covers(generation, want))
+    {
+        cache.stats.slotHits++;
+    }
+    else
+    {
+        cache.stats.slotMisses++;
+        entry.rows = rankSlots(want);
+        entry.depth = want;
+        entry.generation = generation;
+        entry.valid = true;
+    }
+
+    size_t n = min(want, entry.rows.size());
+    return vector<SlotCount>(entry.rows.begin(), entry.rows.begin() + n);
+}
+
+vector<DayCount> TripAnalyzer::tripsPerDay() const
+{
+    // Day totals over all zones
+    DenseCounts days;
+    for (uint32_t id = 0; id < tables.size(); ++id)
+        days.merge(tables.days(id));
+
+    vector<pair<int64_t, long long>> sorted;
+    days.forEach([&](int64_t day, long long count) { sorted.push_back({ day, count }); });
+    sort(sorted.begin(), sorted.end());
+
+    vector<DayCount> results;
+    results.reserve(sorted.size());
+    for (const auto& [day, count] : sorted)
+        results.push_back({ formatDay(day), count });
+
+    return results;
+}
+
+vector<DayCount> TripAnalyzer::busiestDays(int k) const
+{
+    if (k <= 0)
+        return {};
+
+    // The date string order is the day number order
+    vector<DayCount> all = tripsPerDay();
+    auto better = [](const DayCount& a, const DayCount& b) {
         if (a.count != b.count)
-            return a.count > b.count; 
-        
-        // Secondary sort key: zone ID (ascending)
-        return a.zone < b.zone; 
-    });
+            return a.count > b.count;
+        return a.date < b.date;
+    };
+
+    auto top = makeTopK<DayCount>(static_cast<size_t>(k), better);
+    for (const DayCount& d : all)
+        top.offer(d);
+    return top.take();
+}
+
+vector<ZoneDayCount> TripAnalyzer::topZoneDays(int k) const
+{
+    if (k <= 0)
+        return {};
+
+    const ZoneDictionary& zones = tables.zones();
+
+    // (zone id, day) handle, the count travels with it
+    struct ZoneDay {
+        uint32_t id;
+        int64_t day;
+        long long count;
+    };
+
+    auto better = [&](const ZoneDay& a, const ZoneDay& b) {
+        if (a.count != b.count)
+            return a.count > b.count;
+        if (a.id != b.id)
+            return zones.name(a.id) < zones.name(b.id);
+        return a.day < b.day;
+    };
 
-    results.resize(topK);
+    auto top = makeTopK<ZoneDay>(static_cast<size_t>(k), better);
+    for (uint32_t id = 0; id < tables.size(); ++id)
+        tables.days(id).forEach([&](int64_t day, long long count) { top.offer({ id, day, count }); });
 
+    vector<ZoneDayCount> results;
+    for (const ZoneDay& zd : top.take())
+        results.push_back({ zones.name(zd.id), formatDay(zd.day), zd.count });
     return results;
 }
 
-std::vector<SlotCount> TripAnalyzer::topBusySlots(int k) const 
+vector<MinuteCount> TripAnalyzer::busiestMinutes(int k) const
 {
-    vector<SlotCount> results;
-    
-    // Heuristic preallocation:
-    // In practice, most zones are active in only a few hours (e.g., rush hours),
-    // but this reserves an upper bound to reduce reallocations.
-    // Worst-case: every zone active in all 24 hours.
-    results.reserve(slotCountMap.size() * 24); 
-    
-    for (const auto& [zone, hours] : slotCountMap) 
+    if (k <= 0)
+        return {};
+
+    using Entry = pair<int64_t, long long>;
+    auto better = [](const Entry& a, const Entry& b) {
+        if (a.second != b.second)
+            return a.second > b.second;
+        return a.first < b.first;
+    };
+
+    auto top = makeTopK<Entry>(static_cast<size_t>(k), better);
+    tables.minutes().forEach([&](int64_t minute, long long count) { top.offer({ minute, count }); });
+
+    vector<MinuteCount> results;
+    for (const Entry& e : top.take())
+        results.push_back({ formatMinute(e.first), e.second });
+    return results;
+}
+
+vector<ZoneAmount> TripAnalyzer::rankAmounts(int k, bool byFare) const
+{
+    if (k <= 0)
+        return {};
+
+    const ZoneDictionary& zones = tables.zones();
+    auto sumOf = [&](uint32_t id) {
+        const TripAmounts& a = tables.amounts(id, -1);
+        return byFare ? a.fare.sum : a.distance.sum;
+    };
+
+    auto better = [&](uint32_t a, uint32_t b) {
+        long long sa = sumOf(a);
+        long long sb = sumOf(b);
+        if (sa != sb)
+            return sa > sb;
+        return zones.name(a) < zones.name(b);
+    };
+
+    auto top = makeTopK<uint32_t>(static_cast<size_t>(k), better);
+    for (uint32_t id = 0; id < tables.size(); ++id)
     {
-        // Iterate over all 24 possible hours
-        for (int h = 0; h < 24; ++h) 
+        if (tables.amounts(id, -1).trips > 0)
+            top.offer(id);
+    }
+
+    vector<ZoneAmount> results;
+    for (uint32_t id : top.take())
+    {
+        const TripAmounts& a = tables.amounts(id, -1);
+        results.push_back({ zones.name(id), a.trips, byFare ? a.fare : a.distance });
+    }
+    return results;
+}
+
+vector<ZoneAmount> TripAnalyzer::topZonesByRevenue(int k) const
+{
+    return rankAmounts(k, true);
+}
+
+vector<ZoneAmount> TripAnalyzer::topZonesByDistance(int k) const
+{
+    return rankAmounts(k, false);
+}
+
+TripAmounts TripAnalyzer::zoneAmounts(const string& zone, int hour) const
+{
+    uint32_t id = tables.zones().find(zone);
+    if (id == ZoneDictionary::npos || hour < -1 || hour > 23)
+        return {};
+
+    return tables.amounts(id, hour);
+}
+
+long long TripAnalyzer::rejectedAmounts() const
+{
+    return tables.rejectedAmounts();
+}
+
+vector<RouteCount> TripAnalyzer::rankRoutes(int k, uint32_t origin) const
+{
+    if (k <= 0)
+        return {};
+
+    const ZoneDictionary& zones = tables.zones();
+    const ZoneDictionary& dropoffs = tables.dropoffs();
+
+    using Entry = pair<uint64_t, long long>;
+    auto better = [&](const Entry& a, const Entry& b) {
+        if (a.second != b.second)
+            return a.second > b.second;
+
+        uint32_t fromA = static_cast<uint32_t>(a.first >> 32);
+        uint32_t fromB = static_cast<uint32_t>(b.first >> 32);
+        if (fromA != fromB)
+            return zones.name(fromA) < zones.name(fromB);
+
+        return dropoffs.name(static_cast<uint32_t>(a.first)) < dropoffs.name(static_cast<uint32_t>(b.first));
+    };
+
+    // O(routes) scan, no dense matrix and no per-origin index to keep up
+    auto top = makeTopK<Entry>(static_cast<size_t>(k), better);
+    tables.routes().forEach([&](uint64_t key, long long count) {
+        if (origin == ZoneDictionary::npos || static_cast<uint32_t>(key >> 32) == origin)
+            top.offer({ key, count });
+    });
+
+    vector<RouteCount> results;
+    for (const Entry& e : top.take())
+        results.push_back({ zones.name(static_cast<uint32_t>(e.first >> 32)),
+                            dropoffs.name(static_cast<uint32_t>(e.first)), e.second });
+    return results;
+}
+
+vector<RouteCount> TripAnalyzer::topRoutes(int k) const
+{
+    return rankRoutes(k, ZoneDictionary::npos);
+}
+
+vector<RouteCount> TripAnalyzer::topDestinationsFrom(const string& zone, int k) const
+{
+    uint32_t origin = tables.zones().find(zone);
+    if (origin == ZoneDictionary::npos)
+        return {};
+
+    return rankRoutes(k, origin);
+}
+
+template <class Granularity>
+vector<TimeSlotCount> TripAnalyzer::topSlots(int k) const
+{
+    if (k <= 0)
+        return {};
+
+    const ZoneDictionary& zones = tables.zones();
+
+    struct Slot {
+        uint32_t id;
+        int slot;
+    };
+
+    auto better = [&](const Slot& a, const Slot& b) {
+        long long ca = tables.slots<Granularity>(a.id)[a.slot];
+        long long cb = tables.slots<Granularity>(b.id)[b.slot];
+
+        // Primary key: trip count (descending)
+        if (ca != cb)
+            return ca > cb;
+
+        // Secondary key: zone ID (ascending)
+        if (a.id != b.id)
+            return zones.name(a.id) < zones.name(b.id);
+
+        // Tertiary key: slot (ascending)
+        return a.slot < b.slot;
+    };
+
+    auto top = makeTopK<Slot>(static_cast<size_t>(k), better);
+    for (uint32_t id = 0; id < tables.size(); ++id)
+    {
+        const SlotArray<Granularity>& counts = tables.slots<Granularity>(id);
+
+        // kSlots is a constant, the compiler unrolls this
+        for (int s = 0; s < Granularity::kSlots; ++s)
         {
-            if (static_cast<size_t>(h) < hours.size() && hours[h] > 0)
-                results.push_back({zone, h, hours[h]});
+            if (counts[s] > 0)
+                top.offer({ id, s });
         }
     }
 
-    if (k <= 0 || results.empty())
+    vector<TimeSlotCount> results;
+    for (const Slot& s : top.take())
+        results.push_back({ zones.name(s.id), s.slot * Granularity::kMinutes,
+                            tables.slots<Granularity>(s.id)[s.slot] });
+
+    return results;
+}
+
+template vector<TimeSlotCount> TripAnalyzer::topSlots<HourSlots>(int) const;
+template vector<TimeSlotCount> TripAnalyzer::topSlots<QuarterHourSlots>(int) const;
+template vector<TimeSlotCount> TripAnalyzer::topSlots<FiveMinuteSlots>(int) const;
+
+vector<WeeklySlotCount> TripAnalyzer::topWeeklySlots(int k) const
+{
+    if (k <= 0)
         return {};
 
-    size_t topK = (min)(static_cast<size_t>(k), results.size());
+    const ZoneDictionary& zones = tables.zones();
+
+    // (zone id, weekday * 24 + hour) handle, same idea as rankSlots
+    struct Slot {
+        uint32_t id;
+        int index;
+    };
+
+    auto better = [&](const Slot& a, const Slot& b) {
+        long long ca = tables.weekHours(a.id)[a.index];
+        long long cb = tables.weekHours(b.id)[b.index];
 
-    // OPTIMIZATION: partial_sort for Top K
-    partial_sort(results.begin(), 
-                      results.begin() + topK, 
-                      results.end(), 
-                      [](const SlotCount& a, const SlotCount& b) {
-        
         // Primary key: trip count (descending)
+        if (ca != cb)
+            return ca > cb;
+
+        // Secondary key: zone ID (ascending)
+        if (a.id != b.id)
+            return zones.name(a.id) < zones.name(b.id);
+
+        // Then weekday and hour (ascending), the index order
+        return a.index < b.index;
+    };
+
+    auto top = makeTopK<Slot>(static_cast<size_t>(k), better);
+    for (uint32_t id = 0; id < tables.size(); ++id)
+    {
+        const WeekHours& counts = tables.weekHours(id);
+        for (int i = 0; i < 7 * 24; ++i)
+        {
+            if (counts[i] > 0)
+                top.offer({ id, i });
+        }
+    }
+
+    vector<WeeklySlotCount> results;
+    for (const Slot& s : top.take())
+        results.push_back({ zones.name(s.id), s.index / 24, s.index % 24, tables.weekHours(s.id)[s.index] });
+
+    return results;
+}
+
+HeavyHitterBounds TripAnalyzer::heavyHitterBounds() const
+{
+    HeavyHitterBounds bounds;
+    bounds.rows = tables.zoneSummary().total();
+    bounds.zoneError = tables.zoneSummary().minCount();
+    bounds.slotError = tables.slotSummary().minCount();
+    return bounds;
+}
+
+long long TripAnalyzer::duplicateTrips() const
+{
+    return tripIds.duplicates();
+}
+
+long long TripAnalyzer::decodeErrors() const
+{
+    return damagedInputs;
+}
+
+bool TripAnalyzer::checkpointSkipped() const
+{
+    return skippedCheckpoint;
+}
+
+long long TripAnalyzer::estimateSlot(const string& zone, int hour) const
+{
+    if (hour < 0 || hour > 23)
+        return 0;
+
+    if (tables.sketches())
+        return tables.sketch().estimate(ZoneStatsTable::slotHash(zone, hour));
+
+    // No records in approximate mode, the slot summary's upper estimate
+    if (tables.approximate())
+        return tables.slotSummary().estimate(zone, hour);
+
+    // No sketch: the exact count
+    uint32_t id = tables.zones().find(zone);
+    return id == ZoneDictionary::npos ? 0 : tables.stats(id).hours[hour];
+}
+
+long long TripAnalyzer::sketchError() const
+{
+    const CountMinSketch& sketch = tables.sketch();
+    if (sketch.empty())
+        return 0;
+
+    // epsilon = e / width
+    return static_cast<long long>(ceil(exp(1.0) * double(sketch.total()) / double(sketch.width())));
+}
+
+string TripAnalyzer::exportSketch() const
+{
+    return tables.sketch().encode();
+}
+
+bool TripAnalyzer::mergeSketch(const string& bytes)
+{
+    CountMinSketch part;
+    return CountMinSketch::decode(bytes, part) && tables.mergeSketch(part);
+}
+
+IoStats TripAnalyzer::ioStats() const
+{
+    return lastIo;
+}
+
+CacheStats TripAnalyzer::cacheStats() const
+{
+    lock_guard<mutex> guard(cache.lock);
+    return cache.stats;
+}
+
+// Summary entries in query order: count desc, name asc, tag asc
+static vector<SpaceSaving::Entry> rankSummary(const SpaceSaving& summary, size_t k)
+{
+    auto better = [](const SpaceSaving::Entry& a, const SpaceSaving::Entry& b) {
         if (a.count != b.count)
-            return a.count > b.count; 
+            return a.count > b.count;
+        if (a.name != b.name)
+            return a.name < b.name;
+        return a.tag < b.tag;
+    };
+
+    auto top = makeTopK<SpaceSaving::Entry>(k, better);
+    summary.forEach([&top](const SpaceSaving::Entry& e) { top.offer(e); });
+    return top.take();
+}
+
+std::vector<ZoneCount> TripAnalyzer::rankZones(size_t k) const 
+{
+    // Approximate mode: counts are upper bounds, see heavyHitterBounds()
+    if (tables.approximate())
+    {
+        vector<ZoneCount> results;
+        for (const SpaceSaving::Entry& e : rankSummary(tables.zoneSummary(), k))
+            results.push_back({ e.name, e.count });
+        return results;
+    }
+
+    const ZoneDictionary& zones = tables.zones();
+
+    // Ranks zone ids without copying their names
+    auto better = [&](uint32_t a, uint32_t b) {
+        long long ca = tables.stats(a).total;
+        long long cb = tables.stats(b).total;
+
+        // Primary sort key: total trip count (descending)
+        if (ca != cb)
+            return ca > cb;
+
+        // Secondary sort key: zone ID (ascending)
+        return zones.name(a) < zones.name(b);
+    };
+
+    // BOUNDED HEAP:
+    // - Keeps only the K best ids seen so far, O(N log K) time, O(K) memory
+    // - Only the K winning zone strings are ever copied
+    auto top = makeTopK<uint32_t>(k, better);
+    for (uint32_t id = 0; id < tables.size(); ++id)
+        top.offer(id);
+
+    vector<ZoneCount> results;
+    for (uint32_t id : top.take())
+        results.push_back({ zones.name(id), tables.stats(id).total });
+
+    return results;
+}
+
+std::vector<SlotCount> TripAnalyzer::rankSlots(size_t k) const 
+{
+    if (tables.approximate())
+    {
+        vector<SlotCount> results;
+        for (const SpaceSaving::Entry& e : rankSummary(tables.slotSummary(), k))
+            results.push_back({ e.name, e.tag, e.count });
+        return results;
+    }
+
+    const ZoneDictionary& zones = tables.zones();
+
+    // (zone id, hour) handle, the count is looked up in the record
+    struct Slot {
+        uint32_t id;
+        int hour;
+    };
+
+    auto better = [&](const Slot& a, const Slot& b) {
+        long long ca = tables.stats(a.id).hours[a.hour];
+        long long cb = tables.stats(b.id).hours[b.hour];
+
+        // Primary key: trip count (descending)
+        if (ca != cb)
+            return ca > cb;
 
         // Secondary key: zone ID (ascending)
-        if (a.zone != b.zone)
-            return a.zone < b.zone; 
+        if (a.id != b.id)
+            return zones.name(a.id) < zones.name(b.id);
 
         // Tertiary key: hour (ascending)
-        return a.hour < b.hour; 
-    });
+        return a.hour < b.hour;
+    };
 
-    results.resize(topK);
+    auto top = makeTopK<Slot>(k, better);
+    for (uint32_t id = 0; id < tables.size(); ++id) 
+    {
+        const auto& hours = tables.stats(id).hours;
 
-    return results;
+        // Iterate over all 24 possible hours
+        for (int h = 0; h < 24; ++h) 
+        {
+            if (hours[h] > 0)
+                top.offer({ id, h });
+        }
+    }
 
+    vector<SlotCount> results;
+    for (const Slot& s : top.take())
+        results.push_back({ zones.name(s.id), s.hour, tables.stats(s.id).hours[s.hour] });
+
+    return results;
 }
@@ -1,7 +1,16 @@
 #pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map> // Hash table-based container for its time efficiency 
+#include "async_reader.h"
+#include "tail_follow.h"
+#include "trip_id_filter.h"
+#include "zone_stats.h"
 
 // Holds a zone ID and total trip count
 // To identify high density traffic zones
@@ -18,22 +27,461 @@ struct SlotCount {
     long long count;
 };
 
+// Trips on one calendar day, date is "YYYY-MM-DD"
+struct DayCount {
+    std::string date;
+    long long count;
+};
+
+// Trips from one zone on one calendar day
+struct ZoneDayCount {
+    std::string zone;
+    std::string date;
+    long long count;
+};
+
+// Trips in one minute, minute is "YYYY-MM-DD HH:MM"
+struct MinuteCount {
+    std::string minute;
+    long long count;
+};
+
+// Distance or fare totals of one zone, see topZonesByRevenue
+// Values are fixed point with three decimals (decimal.h)
+struct ZoneAmount {
+    std::string zone;
+    long long trips;       // trips with a well-formed distance and fare
+    AmountStats amount;
+};
+
+// Trips from one zone in one time-of-day slot of a SlotGranularity
+struct TimeSlotCount {
+    std::string zone;
+    int minute;            // first minute of the slot, 0–1439
+    long long count;
+};
+
+// Trips from one zone in one hour of the week
+struct WeeklySlotCount {
+    std::string zone;
+    int weekday;           // 0 (Monday) – 6 (Sunday)
+    int hour;              // 0–23
+    long long count;
+};
+
+// Trips from one pickup zone to one dropoff zone
+struct RouteCount {
+    std::string origin;
+    std::string destination;
+    long long count;
+};
+
+// Ingestion tuning knobs
+// Defaults reproduce the reference behaviour
+struct AnalyzerOptions {
+    // Parse regular files in place through mmap
+    // Files that can't be mapped are read with ingestFd instead
+    bool useMmap = true;
+
+    // Worker threads for mapped files, ingestFiles and zstd frame
+    // decoding, 0 means one per core. With dedupeTripIds rows are parsed
+    // on one thread whatever this says, see there
+    unsigned threads = 1;
+
+    // Smallest byte range handed to a single worker
+    std::size_t minChunkBytes = 1 << 20;
+
+    // Read size for streams, pipes and anything else that can't be mapped
+    std::size_t readBlockBytes = 1 << 20;
+
+    // Remember the last ranked results until the aggregates change
+    bool cacheResults = true;
+
+    // Read plain files with several block reads in flight instead of
+    // mapping them, so parsing overlaps the disk. Worth it on cold caches
+    // and network storage, where page faults on a mapping stall the parser
+    bool asyncIo = false;
+
+    // Reads of readBlockBytes kept in flight by asyncIo
+    unsigned ioQueueDepth = 4;
+
+    // asyncIo uses io_uring when the kernel allows it, a pread thread otherwise
+    bool useIoUring = true;
+
+    // Non-empty: ingestFile saves a checkpoint here every
+    // checkpointEveryBytes of a mapped plain CSV, and a later ingestFile of
+    // the unchanged file resumes from it. Removed once the file is done.
+    // Checkpoints hold the hour counts only, so with any track* option or
+    // the approximate mode none is written or resumed. Neither is one with
+    // asyncIo, for compressed or unmappable files, or by ingestFiles;
+    // checkpointSkipped() tells when that happened
+    std::string checkpointPath;
+
+    // Bytes parsed between two checkpoints, each one costs a write and an
+    // fsync of the aggregates
+    std::size_t checkpointEveryBytes = std::size_t(256) << 20;
+    // Count trips per (zone, calendar day) and per minute for the time
+    // series queries. Off by default, the hour counts don't need them.
+    // Snapshots, checkpoints and exportAggregates carry the hour counts only
+    bool trackDays = false;
+    bool trackMinutes = false;
+
+    // Parse DistanceKm and FareAmount and keep their sums, minima and
+    // maxima per zone and per (zone, hour). Rows with a malformed value
+    // are still counted as trips but left out of these totals.
+    // Not carried by snapshots, checkpoints or exportAggregates either
+    bool trackAmounts = false;
+
+    // Count trips per (PickupZoneID, DropoffZoneID) for the route queries
+    // Costs a second zone lookup per row. Rows with an empty dropoff are
+    // counted as trips but not as routes. Not in snapshots either
+    bool trackRoutes = false;
+
+    // Count trips per (zone, weekday, hour) for topWeeklySlots
+    // The weekday comes from the decoded pickup date, the counters are an
+    // array per zone id, so no extra lookup. Not in snapshots either
+    bool trackWeekdays = false;
+
+    // Count trips per (zone, 15-minute slot) and (zone, 5-minute slot)
+    // for topQuarterHourSlots / topFiveMinuteSlots. Fixed-size arrays per
+    // zone id, 96 and 288 counters. Not in snapshots either
+    bool trackQuarterHours = false;
+    bool trackFiveMinutes = false;
+
+    // Non-zero: bounded-memory approximate mode. Zones and (zone, hour)
+    // slots are counted in two Space-Saving summaries of this many
+    // entries each instead of exact tables, so memory no longer grows
+    // with the number of distinct zones. topZones / topBusySlots return
+    // estimates within heavyHitterBounds(); the track* aggregates,
+    // snapshots and checkpoints don't apply in this mode
+    std::size_t heavyHitterCapacity = 0;
+
+    // sketchEpsilon in (0, 1): also build a Count-Min sketch of the
+    // (zone, hour) counts for estimateSlot, in exact or approximate mode.
+    // An estimate is never below the true count, and exceeds it by more
+    // than sketchEpsilon * rows with probability at most sketchDelta.
+    // Memory is about (e / sketchEpsilon) * ln(1 / sketchDelta) * 8 bytes,
+    // whatever the number of zones
+    double sketchEpsilon = 0;
+    double sketchDelta = 0.01;
+
+    // Drop rows whose TripID this analyzer already counted, e.g. batches
+    // an upstream replays. Only valid rows record their id, so a dirty
+    // first copy doesn't hide a good second one. Rows are parsed on one
+    // thread so the first copy in input order is the one kept, threads
+    // only speeds up zstd decoding then. Target: at most 50 ns a row on
+    // top of the plain single-threaded ingest for numeric ids in order,
+    // see make bench ARGS=dedupe.
+    // merge and mergeAggregates add counts as they are, and snapshots
+    // don't carry the ids seen. Neither do checkpoints, so with this on
+    // none is written or resumed
+    bool dedupeTripIds = false;
+};
+
+// Error bounds of the approximate mode (heavyHitterCapacity)
+// A reported zone count c satisfies  c - zoneError <= true count <= c,
+// and every zone with more than zoneError trips is reported by a large
+// enough topZones(k); the same for slots. Both errors are at most
+// rows / heavyHitterCapacity
+struct HeavyHitterBounds {
+    long long rows = 0;         // rows counted by the summaries
+    long long zoneError = 0;
+    long long slotError = 0;
+};
+
+// Counters for the ranked result cache
+struct CacheStats {
+    unsigned long long zoneHits = 0;
+    unsigned long long zoneMisses = 0;
+    unsigned long long slotHits = 0;
+    unsigned long long slotMisses = 0;
+};
+
 class TripAnalyzer {
 public:
+    TripAnalyzer() = default;
+    explicit TripAnalyzer(const AnalyzerOptions& opts);
+
     // Parse Trips.csv, skip dirty rows, never crash
     void ingestFile(const std::string& csvPath);
 
+    // Same rules for rows read from a stream (stdin, pipes, string streams)
+    // Reads in readBlockBytes blocks, a row may straddle two blocks
+    void ingestStream(std::istream& in);
+
+    // Same as ingestStream for a raw file descriptor, read until EOF
+    // The descriptor is left open
+    void ingestFd(int fd);
+
+    // Ingests several files at once, same result as calling ingestFile on
+    // each in turn. Files and chunks of large files are shared between the
+    // worker threads through a work-stealing pool, so one big file doesn't
+    // leave the other threads idle. checkpointPath and ioStats apply to
+    // ingestFile only, these files are never checkpointed or timed
+    void ingestFiles(const std::vector<std::string>& csvPaths);
+
+    // ingestFiles on the regular files in directory whose name matches
+    // pattern ('*' and '?' wildcards), returns how many files that was
+    std::size_t ingestDirectory(const std::string& directory,
+                                const std::string& pattern = "*.csv");
+
+    // Follow mode for a CSV that is still being written
+    // Ingests the complete rows already there and remembers the offset,
+    // returns false if the file can't be opened
+    bool follow(const std::string& csvPath);
+
+    // Waits up to timeoutMs for the followed file to grow, then ingests the
+    // rows appended since the last call. A trailing row without its '\n'
+    // waits for the next poll. Returns the bytes ingested, 0 if not following
+    std::size_t pollFollow(int timeoutMs = 0);
+
+    void stopFollowing();
+
+    // Bytes of the followed file ingested so far
+    std::uint64_t followOffset() const;
+
     // Top K zones: count desc, zone asc
     std::vector<ZoneCount> topZones(int k = 10) const;
 
     // Top K slots: count desc, zone asc, hour asc
     std::vector<SlotCount> topBusySlots(int k = 10) const;
+
+    // Time series queries, empty unless trackDays / trackMinutes is on
+    // Every day with trips, oldest first
+    std::vector<DayCount> tripsPerDay() const;
+
+    // Top K days: count desc, date asc
+    std::vector<DayCount> busiestDays(int k = 10) const;
+
+    // Top K (zone, day) pairs: count desc, zone asc, date asc
+    std::vector<ZoneDayCount> topZoneDays(int k = 10) const;
+
+    // Top K minutes over all zones: count desc, minute asc
+    std::vector<MinuteCount> busiestMinutes(int k = 10) const;
+
+    // Distance and fare queries, empty unless trackAmounts is on
+    // Top K zones by fare sum: sum desc, zone asc
+    std::vector<ZoneAmount> topZonesByRevenue(int k = 10) const;
+
+    // Top K zones by distance sum: sum desc, zone asc
+    std::vector<ZoneAmount> topZonesByDistance(int k = 10) const;
+
+    // Amounts of one zone, in one hour (0–23) or all of them (-1)
+    TripAmounts zoneAmounts(const std::string& zone, int hour = -1) const;
+
+    // Counted trips whose distance or fare was malformed
+    long long rejectedAmounts() const;
+
+    // Top K (zone, slot) pairs at a compile-time granularity: HourSlots
+    // (always there), QuarterHourSlots or FiveMinuteSlots (empty unless
+    // tracked). count desc, zone asc, minute asc
+    template <class Granularity>
+    std::vector<TimeSlotCount> topSlots(int k = 10) const;
+
+    std::vector<TimeSlotCount> topQuarterHourSlots(int k = 10) const { return topSlots<QuarterHourSlots>(k); }
+    std::vector<TimeSlotCount> topFiveMinuteSlots(int k = 10) const { return topSlots<FiveMinuteSlots>(k); }
+
+    // Top K (zone, weekday, hour) slots, empty unless trackWeekdays is on
+    // count desc, zone asc, weekday asc, hour asc
+    std::vector<WeeklySlotCount> topWeeklySlots(int k = 10) const;
+
+    // Route queries, empty unless trackRoutes is on
+    // Top K routes: count desc, origin asc, destination asc
+    std::vector<RouteCount> topRoutes(int k = 10) const;
+
+    // Top K routes starting in zone, same order
+    std::vector<RouteCount> topDestinationsFrom(const std::string& zone, int k = 10) const;
+
+    // Writes the aggregates to a versioned, checksummed binary file
+    // Returns false in the approximate mode, snapshots hold exact
+    // records and not the Space-Saving summaries
+    bool saveSnapshot(const std::string& path) const;
+
+    // Replaces the aggregates with a saved snapshot
+    // Returns false and keeps the current state if the file is unusable
+    // or this analyzer is in the approximate mode
+    bool loadSnapshot(const std::string& path);
+
+    // Folds another analyzer's aggregates into this one
+    // Cost is O(distinct zones of other), the result matches ingesting
+    // both inputs into a single analyzer. Returns false and changes
+    // nothing if only one of them is in the approximate mode
+    bool merge(const TripAnalyzer& other);
+
+    // Same, but may steal other's tables, leaves other empty
+    bool merge(TripAnalyzer&& other);
+
+    // Partial aggregates as bytes for shipping between workers
+    // Same encoding as a snapshot file, empty in the approximate mode
+    std::string exportAggregates() const;
+
+    // Merges bytes produced by exportAggregates()
+    // Returns false and changes nothing if they are malformed or this
+    // analyzer is in the approximate mode
+    bool mergeAggregates(const std::string& bytes);
+
+    // Trips from zone in hour, from the Count-Min sketch when there is
+    // one (see sketchEpsilon). Without one, the exact count, or in
+    // approximate mode the slot summary's upper estimate (the count of a
+    // monitored slot, slotError otherwise). Never below the true count.
+    // Rows loaded from snapshots or merged from aggregates are added to
+    // the sketch as they arrive
+    long long estimateSlot(const std::string& zone, int hour) const;
+
+    // Additive error of estimateSlot that holds with probability
+    // 1 - sketchDelta, 0 without a sketch
+    long long sketchError() const;
+
+    // The sketch as bytes, for mergeSketch on another analyzer
+    std::string exportSketch() const;
+
+    // Adds a sketch from exportSketch() of an analyzer with the same
+    // sketchEpsilon and sketchDelta. Returns false and changes nothing
+    // if the bytes are malformed or the dimensions differ
+    bool mergeSketch(const std::string& bytes);
+
+    // Error bounds of topZones / topBusySlots in approximate mode, all
+    // zero in exact mode
+    HeavyHitterBounds heavyHitterBounds() const;
+
+    // Rows dropped by dedupeTripIds so far
+    long long duplicateTrips() const;
+
+    // Compressed files ingested so far that were truncated or corrupt
+    // (only the rows before the damage are counted), or skipped because
+    // their codec isn't built in
+    long long decodeErrors() const;
+
+    // True if checkpointPath is set but the last ingestFile or ingestFiles
+    // neither wrote nor resumed a checkpoint, see checkpointPath
+    bool checkpointSkipped() const;
+
+    // Hit/miss counts of the topZones/topBusySlots cache
+    CacheStats cacheStats() const;
+
+    // Where the last asyncIo ingestFile spent its time, ingestFiles
+    // doesn't update it
+    IoStats ioStats() const;
 private:
-    // Key: PickupZoneID
-    // Value: TotalTripCount
-    std::unordered_map<std::string, long long> zoneCountMap;
+    // Ranked result of one query kind, valid for one generation
+    template <class Row>
+    struct RankCache {
+        std::uint64_t generation = 0;
+        bool valid = false;
+        std::size_t depth = 0;  // k the rows were computed for
+        std::vector<Row> rows;
+
+        // The ranking is total, so any k <= depth is a prefix of rows,
+        // and a short result means every candidate is already in it
+        bool covers(std::uint64_t gen, std::size_t k) const
+        {
+            return valid && generation == gen && (k <= depth || rows.size() < depth);
+        }
+    };
+
+    // Mutable cache behind the const queries, guarded by its own lock
+    // Copies of an analyzer start with an empty cache
+    struct QueryCache {
+        std::mutex lock;
+        RankCache<ZoneCount> zones;
+        RankCache<SlotCount> slots;
+        CacheStats stats;
+
+        QueryCache() = default;
+        QueryCache(const QueryCache&) {}
+        QueryCache& operator=(const QueryCache&) { return *this; }
+    };
+
+    // Follow mode state, copies of an analyzer don't follow anything
+    struct FollowState {
+        std::unique_ptr<FileFollower> file;
+
+        FollowState() = default;
+        FollowState(const FollowState&) {}
+        FollowState& operator=(const FollowState&) { file.reset(); return *this; }
+    };
+
+    // Uncached ranking over the whole table
+    std::vector<ZoneCount> rankZones(std::size_t k) const;
+    std::vector<SlotCount> rankSlots(std::size_t k) const;
+    std::vector<ZoneAmount> rankAmounts(int k, bool byFare) const;
+
+    // Routes from origin, or all of them for ZoneDictionary::npos
+    std::vector<RouteCount> rankRoutes(int k, std::uint32_t origin) const;
+
+    // Called after every change to tables, drops cached rankings
+    void aggregatesChanged() { ++generation; }
+
+    // Validates one CSV row and aggregates it into the given tables
+    // commas holds the offsets of the row's first commaCount commas
+    // With tripIds, a valid row whose TripID is already in it is dropped
+    static void ingestFields(const char* rowBegin, std::size_t length,
+                             const std::size_t* commas, int commaCount,
+                             ZoneStatsTable& out, TripIdFilter* tripIds = nullptr);
+
+    // Aggregates every row of an in-memory block of whole lines
+    static void ingestRange(const char* begin, const char* end, ZoneStatsTable& out,
+                            TripIdFilter* tripIds = nullptr);
+
+    // The filter rows into tables go through, null unless dedupeTripIds
+    TripIdFilter* tripIdFilter() { return options.dedupeTripIds ? &tripIds : nullptr; }
+
+    // Splits a buffer on line boundaries across worker threads
+    void ingestBuffer(const char* data, std::size_t length);
+
+    // Worker count for length bytes: 1 below 2 * minChunkBytes or with
+    // dedupeTripIds, at most the thread count
+    std::size_t chunkCount(std::size_t length) const;
+
+    // Cuts a buffer into up to parts.size() ranges that end right after a
+    // '\n' and parses range i into parts[i], one thread per range
+    static void ingestChunks(const char* data, std::size_t length,
+                             std::vector<ZoneStatsTable>& parts);
+
+    // mmap path, also decodes gzip/zstd files
+    // Returns false when the file can't be mapped, or is plain CSV
+    // and useMmap is off
+    bool ingestMapped(const std::string& csvPath);
+
+    // asyncIo path for plain files
+    // Returns false before parsing anything if the file can't be opened
+    // that way or turns out to be compressed
+    bool ingestAsync(const std::string& csvPath);
+
+    // ingestBuffer in checkpointEveryBytes steps with a checkpoint after
+    // each, starting from a saved checkpoint of the same file if there is one
+    void ingestCheckpointed(const std::string& csvPath, const char* data, std::size_t length);
+
+    // Whether a checkpoint image can hold the whole aggregate state
+    bool checkpointable() const;
+
+    // threads option with 0 resolved to the core count
+    unsigned workerThreads() const;
+
+    // Pulls blocks from read(dst, capacity) until it returns 0 and parses
+    // the complete rows of each, carrying a trailing partial row over
+    template <class ReadFn>
+    void ingestBlocks(ReadFn&& read);
+
+    AnalyzerOptions options;
+
+    ZoneStatsTable tables;
+
+    // TripIDs of the rows counted into tables, with dedupeTripIds
+    TripIdFilter tripIds;
+
+    // Bumped whenever tables change, cached rankings carry the value
+    std::uint64_t generation = 0;
+
+    mutable QueryCache cache;
+
+    IoStats lastIo;
+
+    // Compressed inputs that didn't decode to the end
+    long long damagedInputs = 0;
+
+    // Last ingest ran without the checkpoints asked for
+    bool skippedCheckpoint = false;
 
-    // Key: PickupZoneID
-    // Value: Vector of counts per hour (index 0-23)
-    std::unordered_map<std::string, std::vector<long long>> slotCountMap;
+    FollowState following;
 };
\ No newline at end of file
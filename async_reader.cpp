@@ -0,0 +1,477 @@
+#include "async_reader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRIP_HAVE_POSIX_IO
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define TRIP_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+using namespace std;
+
+static double nowMs()
+{
+    using namespace chrono;
+    return duration<double, milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef TRIP_HAVE_IO_URING
+// Raw ring setup, the project doesn't depend on liburing
+struct AsyncFileReader::Uring {
+    int fd = -1;
+    unsigned inflight = 0;
+
+    void* sqRing = MAP_FAILED;
+    size_t sqRingBytes = 0;
+    void* cqRing = MAP_FAILED;
+    size_t cqRingBytes = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesBytes = 0;
+
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+};
+#else
+struct AsyncFileReader::Uring {};
+#endif
+
+AsyncFileReader::~AsyncFileReader()
+{
+    if (reader.joinable())
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        reader.join();
+    }
+
+    closeUring();
+
+#ifdef TRIP_HAVE_POSIX_IO
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+bool AsyncFileReader::open(const string& path, size_t blockSize, unsigned depth, Backend backend)
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    if (fd >= 0)
+        return false;
+
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    // Same rule as MappedFile: only regular files have a size to split
+    struct stat st;
+    if (fstat(file, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        close(file);
+        return false;
+    }
+
+    fd = file;
+    fileSize = static_cast<size_t>(st.st_size);
+    blockBytes = max<size_t>(4096, blockSize);
+    blockCount = (fileSize + blockBytes - 1) / blockBytes;
+
+    // Two buffers is the minimum for any overlap at all
+    slots.resize(max(2u, depth));
+    for (Slot& slot : slots)
+        slot.bytes.resize(blockBytes);
+
+    if (backend != Backend::Pread && startUring())
+    {
+        usingUring = true;
+        totals.backend = "io_uring";
+    }
+    else if (backend == Backend::IoUring)
+    {
+        return false;
+    }
+    else
+    {
+        totals.backend = "pread";
+        // The first `depth` blocks have free buffers from the start
+        issuedBlocks = slots.size();
+        reader = thread(&AsyncFileReader::preadLoop, this);
+    }
+    return true;
+#else
+    (void)path;
+    (void)blockSize;
+    (void)depth;
+    (void)backend;
+    return false;
+#endif
+}
+
+size_t AsyncFileReader::blockLength(size_t block) const
+{
+    size_t offset = block * blockBytes;
+    return min(blockBytes, fileSize - offset);
+}
+
+// Finishes a block from byte `done` with plain pread calls
+// Covers short reads and kernels without IORING_OP_READ
+bool AsyncFileReader::readFully(size_t block, char* dst, size_t done)
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    size_t want = blockLength(block);
+    off_t offset = static_cast<off_t>(block * blockBytes);
+
+    while (done < want)
+    {
+        ssize_t got = pread(fd, dst + done, want - done, offset + static_cast<off_t>(done));
+        if (got < 0 && errno == EINTR)
+            continue;
+
+        // Error, or the file shrank underneath us
+        if (got <= 0)
+            return false;
+
+        done += static_cast<size_t>(got);
+    }
+    return true;
+#else
+    (void)block;
+    (void)dst;
+    (void)done;
+    return false;
+#endif
+}
+
+bool AsyncFileReader::next(const char*& data, size_t& length)
+{
+    double entered = nowMs();
+    if (lastReturn >= 0)
+        totals.parseMs += entered - lastReturn;
+
+    size_t depth = slots.size();
+
+    // The block handed out last time is done with, reuse its buffer
+    if (holding)
+    {
+        holding = false;
+
+        if (usingUring)
+        {
+            if (!failed && issuedBlocks < blockCount && !submitUring(issuedBlocks % depth))
+                failed = true;
+        }
+        else
+        {
+            lock_guard<mutex> guard(lock);
+            issuedBlocks++;
+            changed.notify_all();
+        }
+    }
+
+    if (nextBlock == blockCount)
+        return false;
+
+    Slot& slot = slots[nextBlock % depth];
+
+    if (usingUring)
+    {
+        if (failed || !waitUring(nextBlock % depth))
+        {
+            failed = true;
+            return false;
+        }
+        slot.ready = false;
+    }
+    else
+    {
+        // Blocks read before a failure are still delivered
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&] { return (slot.ready && slot.block == nextBlock) || failed; });
+        if (!slot.ready || slot.block != nextBlock)
+            return false;
+        slot.ready = false;
+    }
+    data = slot.bytes.data();
+    length = slot.length;
+
+    nextBlock++;
+    holding = true;
+    totals.bytes += length;
+    totals.blocks++;
+
+    lastReturn = nowMs();
+    totals.ioWaitMs += lastReturn - entered;
+    return true;
+}
+
+bool AsyncFileReader::ok() const
+{
+    lock_guard<mutex> guard(lock);
+    return !failed;
+}
+
+IoStats AsyncFileReader::stats() const
+{
+    if (usingUring)
+        return totals;
+
+    lock_guard<mutex> guard(lock);
+    return totals;
+}
+
+// Background reader for the pread backend
+// Block b goes into slot b % depth once the caller has released block b - depth
+void AsyncFileReader::preadLoop()
+{
+    size_t depth = slots.size();
+
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        Slot& slot = slots[block % depth];
+        {
+            unique_lock<mutex> guard(lock);
+            double waitStart = nowMs();
+            changed.wait(guard, [&] { return block < issuedBlocks || stopping; });
+            totals.readerStallMs += nowMs() - waitStart;
+            if (stopping)
+                return;
+        }
+
+        bool readOk = readFully(block, slot.bytes.data(), 0);
+
+        {
+            lock_guard<mutex> guard(lock);
+            if (!readOk)
+                failed = true;
+            slot.length = blockLength(block);
+            slot.block = block;
+            slot.ready = readOk;
+        }
+        changed.notify_all();
+
+        if (!readOk)
+            return;
+    }
+}
+
+#ifdef TRIP_HAVE_IO_URING
+
+static int uringSetup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int uringEnter(int ringFd, unsigned submit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, submit, minComplete, flags, nullptr, 0));
+}
+
+bool AsyncFileReader::startUring()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // Seccomp profiles and old kernels refuse this, the caller falls back
+    int ringFd = uringSetup(static_cast<unsigned>(slots.size()), &params);
+    if (ringFd < 0)
+        return false;
+
+    uring = new Uring();
+    Uring& r = *uring;
+    r.fd = ringFd;
+
+    r.sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r.cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // Newer kernels share one mapping for both rings
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+        r.sqRingBytes = r.cqRingBytes = max(r.sqRingBytes, r.cqRingBytes);
+
+    r.sqRing = mmap(nullptr, r.sqRingBytes, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (r.sqRing == MAP_FAILED)
+    {
+        closeUring();
+        return false;
+    }
+
+    if (single)
+        r.cqRing = r.sqRing;
+    else
+        r.cqRing = mmap(nullptr, r.cqRingBytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+
+    r.sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, r.sqesBytes, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    r.sqes = static_cast<io_uring_sqe*>(sqes);
+
+    if (r.cqRing == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        closeUring();
+        return false;
+    }
+
+    char* sq = static_cast<char*>(r.sqRing);
+    char* cq = static_cast<char*>(r.cqRing);
+    r.sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    r.sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    r.sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    r.cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    r.cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    r.cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    r.cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Fill every buffer up front
+    size_t first = min(slots.size(), blockCount);
+    for (size_t i = 0; i < first; i++)
+    {
+        if (!submitUring(i))
+        {
+            closeUring();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Queues a read of block issuedBlocks into slot
+bool AsyncFileReader::submitUring(size_t slotIndex)
+{
+    Uring& r = *uring;
+    Slot& slot = slots[slotIndex];
+
+    slot.block = issuedBlocks++;
+    slot.length = blockLength(slot.block);
+    slot.ready = false;
+
+    unsigned tail = *r.sqTail;
+    unsigned index = tail & r.sqMask;
+
+    io_uring_sqe* sqe = &r.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = static_cast<unsigned long long>(slot.block) * blockBytes;
+    sqe->addr = reinterpret_cast<unsigned long long>(slot.bytes.data());
+    sqe->len = static_cast<unsigned>(slot.length);
+    sqe->user_data = slotIndex;
+
+    r.sqArray[index] = index;
+    // The kernel must see the entry before the new tail
+    __atomic_store_n(r.sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    for (;;)
+    {
+        int submitted = uringEnter(r.fd, 1, 0, 0);
+        if (submitted >= 0)
+            break;
+        if (errno != EINTR && errno != EAGAIN)
+            return false;
+    }
+
+    r.inflight++;
+    return true;
+}
+
+// Reaps completions until slot holds its block
+bool AsyncFileReader::waitUring(size_t slotIndex)
+{
+    Uring& r = *uring;
+
+    while (!slots[slotIndex].ready)
+    {
+        unsigned head = *r.cqHead;
+        unsigned tail = __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE);
+
+        if (head == tail)
+        {
+            if (r.inflight == 0)
+                return false;
+
+            int waited = uringEnter(r.fd, 0, 1, IORING_ENTER_GETEVENTS);
+            if (waited < 0 && errno != EINTR)
+                return false;
+            continue;
+        }
+
+        io_uring_cqe cqe = r.cqes[head & r.cqMask];
+        __atomic_store_n(r.cqHead, head + 1, __ATOMIC_RELEASE);
+        r.inflight--;
+
+        Slot& done = slots[static_cast<size_t>(cqe.user_data)];
+        size_t got = cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0;
+
+        // Short read or an error the kernel reported: finish synchronously
+        if (got < done.length && !readFully(done.block, done.bytes.data(), got))
+            return false;
+
+        done.ready = true;
+    }
+    return true;
+}
+
+void AsyncFileReader::closeUring()
+{
+    if (!uring)
+        return;
+
+    Uring& r = *uring;
+
+    // Buffers must outlive every read the kernel still owns
+    while (r.inflight > 0 && r.cqHead)
+    {
+        unsigned head = *r.cqHead;
+        if (head != __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE))
+        {
+            __atomic_store_n(r.cqHead, head + 1, __ATOMIC_RELEASE);
+            r.inflight--;
+        }
+        else if (uringEnter(r.fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+        {
+            break;
+        }
+    }
+
+    if (r.sqes != MAP_FAILED)
+        munmap(r.sqes, r.sqesBytes);
+    if (r.cqRing != MAP_FAILED && r.cqRing != r.sqRing)
+        munmap(r.cqRing, r.cqRingBytes);
+    if (r.sqRing != MAP_FAILED)
+        munmap(r.sqRing, r.sqRingBytes);
+    if (r.fd >= 0)
+        close(r.fd);
+
+    delete uring;
+    uring = nullptr;
+}
+
+#else
+
+bool AsyncFileReader::startUring() { return false; }
+bool AsyncFileReader::submitUring(size_t) { return false; }
+bool AsyncFileReader::waitUring(size_t) { return false; }
+void AsyncFileReader::closeUring() {}
+
+#endif
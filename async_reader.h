@@ -0,0 +1,99 @@
+#pragma once // prevents multiple inclusions
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where the time of one asynchronous ingest went
+// ioWaitMs high: the disk is the bottleneck, more queue depth or a
+// faster device helps. readerStallMs high: the parser is the bottleneck,
+// more worker threads or a cheaper row format helps.
+struct IoStats {
+    const char* backend = "none";    // "io_uring", "pread" or "none"
+    unsigned long long bytes = 0;    // bytes handed to the parser
+    unsigned long long blocks = 0;
+    double ioWaitMs = 0;        // parser blocked waiting for a read to land
+    double parseMs = 0;         // parser busy between blocks
+    double readerStallMs = 0;   // reader blocked because every buffer was full
+};
+
+// Reads a regular file front to back with `depth` reads in flight, so the
+// next blocks are already arriving while the caller parses the current one
+//
+// Uses io_uring on Linux when the kernel allows it, otherwise a background
+// thread issuing pread() into a ring of buffers. Blocks are returned in
+// file order and stay valid until the following next() call.
+class AsyncFileReader {
+public:
+    enum class Backend { Auto, IoUring, Pread };
+
+    AsyncFileReader() = default;
+    ~AsyncFileReader();
+
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    // Fails for anything that isn't a non-empty regular file,
+    // or when the requested backend isn't available
+    bool open(const std::string& path, std::size_t blockBytes, unsigned depth,
+              Backend backend = Backend::Auto);
+
+    // Next block in file order, false at the end of the file or on a read error
+    bool next(const char*& data, std::size_t& length);
+
+    // False if a read failed before the end of the file
+    bool ok() const;
+
+    // Bytes in the file, as of open()
+    std::size_t size() const { return fileSize; }
+
+    // Timings so far, readerStallMs is only measured by the pread backend
+    IoStats stats() const;
+
+private:
+    // One buffer of the ring and the block it currently holds
+    struct Slot {
+        std::vector<char> bytes;
+        std::size_t length = 0;
+        std::size_t block = 0;
+        bool ready = false;
+    };
+
+    std::size_t blockLength(std::size_t block) const;
+    bool readFully(std::size_t block, char* dst, std::size_t done);
+
+    bool startUring();
+    bool submitUring(std::size_t slot);
+    bool waitUring(std::size_t slot);
+    void closeUring();
+
+    void preadLoop();
+
+    int fd = -1;
+    std::size_t fileSize = 0;
+    std::size_t blockBytes = 0;
+    std::size_t blockCount = 0;
+    std::size_t nextBlock = 0;     // next block handed to the caller
+    std::size_t issuedBlocks = 0;  // blocks given to the reader so far
+    bool holding = false;          // caller still owns the previous block
+    bool failed = false;
+    bool usingUring = false;
+
+    std::vector<Slot> slots;
+
+    // io_uring rings, opaque here so the header stays portable
+    struct Uring;
+    Uring* uring = nullptr;
+
+    // pread backend
+    mutable std::mutex lock;
+    std::condition_variable changed;
+    std::thread reader;
+    bool stopping = false;
+
+    // Timing
+    double lastReturn = -1;    // time next() last returned, ms
+    IoStats totals;
+};
@@ -0,0 +1,576 @@
+// Micro benchmarks for the aggregation internals
+// Usage: ./benchmarks [--rows=N] [section ...]
+// With no section every benchmark runs
+#include "analyzer.h"
+#include "csv_scan.h"
+#include "space_saving.h"
+#include "timestamp.h"
+#include "trip_id_filter.h"
+#include "zone_stats.h"
+
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// ------------------- harness -------------------
+
+// Best of a few runs, in milliseconds
+static double timeMs(const function<void()>& fn, int runs = 3)
+{
+    double best = 1e300;
+    for (int r = 0; r < runs; ++r)
+    {
+        auto t0 = chrono::steady_clock::now();
+        fn();
+        auto t1 = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double, milli>(t1 - t0).count());
+    }
+    return best;
+}
+
+static void report(const char* name, double ms, size_t rows)
+{
+    double nsPerRow = rows ? ms * 1e6 / double(rows) : 0.0;
+    printf("  %-34s %10.2f ms %8.2f ns/row\n", name, ms, nsPerRow);
+}
+
+// Keeps the optimizer from dropping a result
+static volatile long long sink;
+
+// Deterministic xorshift, same data on every run
+struct Rng {
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    uint64_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+// (zone, hour) pairs that already passed row validation
+struct RowSet {
+    vector<string> zoneNames;
+    vector<pair<uint32_t, int>> rows;
+
+    string_view zone(size_t i) const { return zoneNames[rows[i].first]; }
+};
+
+static RowSet syntheticRows(size_t rowCount, size_t zoneCount)
+{
+    RowSet set;
+    set.zoneNames.reserve(zoneCount);
+    for (size_t z = 0; z < zoneCount; ++z)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "ZONE%06zu", z);
+        set.zoneNames.emplace_back(buf);
+    }
+
+    Rng rng;
+    set.rows.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i)
+    {
+        uint64_t r = rng.next();
+        set.rows.push_back({ uint32_t(r % zoneCount), int((r >> 32) % 24) });
+    }
+    return set;
+}
+
+// Pulls zone and hour out of every well formed SmallTrips.csv row
+static RowSet fileRows(const string& path)
+{
+    RowSet set;
+    unordered_map<string, uint32_t> ids;
+
+    ifstream in(path);
+    string line;
+    while (getline(in, line))
+    {
+        size_t c1 = line.find(',');
+        size_t c2 = line.find(',', c1 + 1);
+        size_t c3 = line.find(',', c2 + 1);
+        size_t colon = line.find(':', c3 + 1);
+        if (c1 == string::npos || c2 == string::npos ||
+            c3 == string::npos || colon == string::npos || colon < 2)
+            continue;
+
+        int hour = atoi(line.c_str() + colon - 2);
+        if (hour < 0 || hour > 23)
+            continue;
+
+        string zone = line.substr(c1 + 1, c2 - c1 - 1);
+        auto it = ids.emplace(zone, uint32_t(set.zoneNames.size())).first;
+        if (it->second == set.zoneNames.size())
+            set.zoneNames.push_back(zone);
+
+        set.rows.push_back({ it->second, hour });
+    }
+    return set;
+}
+
+// ------------------- layout -------------------
+
+// The original layout: two string-keyed maps, heap vector per zone
+static long long legacyLayout(const RowSet& set)
+{
+    unordered_map<string, long long> zoneCountMap;
+    unordered_map<string, vector<long long>> slotCountMap;
+    zoneCountMap.reserve(150000);
+    slotCountMap.reserve(150000);
+
+    string keyBuffer;
+    for (size_t i = 0; i < set.rows.size(); ++i)
+    {
+        keyBuffer.assign(set.zone(i));
+        zoneCountMap[keyBuffer]++;
+
+        vector<long long>& hours = slotCountMap[keyBuffer];
+        if (hours.empty())
+            hours.resize(24, 0);
+        hours[set.rows[i].second]++;
+    }
+    return (long long)zoneCountMap.size();
+}
+
+static long long recordLayout(const RowSet& set)
+{
+    ZoneStatsTable table;
+    table.reserve(150000);
+
+    for (size_t i = 0; i < set.rows.size(); ++i)
+        table.add(set.zone(i), set.rows[i].second);
+
+    return (long long)table.size();
+}
+
+static void benchLayout(size_t rowCount)
+{
+    printf("layout: string maps + vector<long long> vs ZoneStats records\n");
+
+    struct Case { string name; RowSet set; };
+    vector<Case> cases;
+    cases.push_back({ "SmallTrips.csv", fileRows("SmallTrips.csv") });
+    cases.push_back({ to_string(rowCount) + " rows / 1K zones", syntheticRows(rowCount, 1000) });
+    cases.push_back({ to_string(rowCount) + " rows / 500K zones", syntheticRows(rowCount, 500000) });
+
+    for (const Case& c : cases)
+    {
+        printf(" %s (%zu rows, %zu zones)\n", c.name.c_str(), c.set.rows.size(), c.set.zoneNames.size());
+        size_t n = c.set.rows.size();
+        report("legacy maps", timeMs([&] { sink = legacyLayout(c.set); }), n);
+        report("ZoneStatsTable", timeMs([&] { sink = recordLayout(c.set); }), n);
+    }
+}
+
+// ------------------- hash -------------------
+
+static long long internStd(const RowSet& set)
+{
+    unordered_map<string, uint32_t> ids;
+    string keyBuffer;
+    long long sum = 0;
+
+    for (size_t i = 0; i < set.rows.size(); ++i)
+    {
+        keyBuffer.assign(set.zone(i));
+        auto it = ids.try_emplace(keyBuffer, uint32_t(ids.size())).first;
+        sum += it->second;
+    }
+    return sum;
+}
+
+static long long internFlat(const RowSet& set)
+{
+    ZoneDictionary dict;
+    long long sum = 0;
+
+    for (size_t i = 0; i < set.rows.size(); ++i)
+        sum += dict.intern(set.zone(i));
+
+    return sum;
+}
+
+static void benchHash(size_t rowCount)
+{
+    printf("hash: std::unordered_map<string, uint32_t> vs ZoneDictionary intern\n");
+
+    for (size_t zones : { size_t(1000), size_t(100000), size_t(1000000) })
+    {
+        RowSet set = syntheticRows(rowCount, zones);
+        printf(" %zu lookups / %zu zones\n", set.rows.size(), zones);
+
+        size_t n = set.rows.size();
+        report("std::unordered_map", timeMs([&] { sink = internStd(set); }), n);
+        report("ZoneDictionary (flat)", timeMs([&] { sink = internFlat(set); }), n);
+    }
+}
+
+// ------------------- scan -------------------
+
+// Synthetic CSV text in memory, shaped like SmallTrips.csv rows
+static string syntheticCsv(size_t rowCount)
+{
+    string text = "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,FareAmount\n";
+    text.reserve(rowCount * 52);
+
+    Rng rng;
+    char buf[96];
+    for (size_t i = 0; i < rowCount; ++i)
+    {
+        uint64_t r = rng.next();
+        int n = snprintf(buf, sizeof(buf), "%zu,ZONE%03u,ZONE%03u,2024-%02u-%02u %02u:%02u,%u.%u,%u.%u\n",
+                         1000000 + i, unsigned(r % 1000), unsigned((r >> 10) % 1000),
+                         unsigned((r >> 20) % 12 + 1), unsigned((r >> 24) % 28 + 1),
+                         unsigned((r >> 29) % 24), unsigned((r >> 34) % 60),
+                         unsigned((r >> 40) % 50), unsigned((r >> 46) % 10),
+                         unsigned((r >> 50) % 200), unsigned((r >> 58) % 10));
+        text.append(buf, size_t(n));
+    }
+    return text;
+}
+
+// The pre-SIMD splitter: memchr per row, find per field
+static long long scanFind(const string& text)
+{
+    long long sum = 0;
+    const char* pos = text.data();
+    const char* end = pos + text.size();
+
+    while (pos < end)
+    {
+        const char* nl = static_cast<const char*>(memchr(pos, '\n', size_t(end - pos)));
+        const char* lineEnd = nl ? nl : end;
+
+        string_view row(pos, size_t(lineEnd - pos));
+        size_t c = row.find(',');
+        for (int f = 0; f < kTrackedCommas && c != string_view::npos; ++f)
+        {
+            sum += (long long)c;
+            c = row.find(',', c + 1);
+        }
+        pos = lineEnd + 1;
+    }
+    return sum;
+}
+
+static long long scanBlocks(const string& text, BlockScanFn scan)
+{
+    long long sum = 0;
+    scanRows(text.data(), text.data() + text.size(), scan,
+             [&sum](const char*, size_t, const size_t* commas, int count) {
+        for (int f = 0; f < count; ++f)
+            sum += (long long)commas[f];
+    });
+    return sum;
+}
+
+static void benchScan(size_t rowCount)
+{
+    printf("scan: row/field splitting over %zu in-memory rows (selected kernel: %s)\n",
+           rowCount, blockScannerName());
+
+    string text = syntheticCsv(rowCount);
+    double mb = double(text.size()) / (1 << 20);
+
+    auto line = [&](const char* name, double ms) {
+        report(name, ms, rowCount);
+        printf("  %-34s %10.0f MB/s\n", "", mb / (ms / 1000.0));
+    };
+
+    line("memchr + find", timeMs([&] { sink = scanFind(text); }));
+
+    size_t count;
+    const BlockScanKernel* kernels = blockScanKernels(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!kernels[i].supported)
+            continue;
+
+        string name = string("block scan / ") + kernels[i].name;
+        line(name.c_str(), timeMs([&] { sink = scanBlocks(text, kernels[i].scan); }));
+    }
+}
+
+// ------------------- hour -------------------
+
+// extractHour as it was before timestamp.h: trim, find ':', from_chars
+static int legacyExtractHour(string_view str)
+{
+    while (!str.empty() && isspace(static_cast<unsigned char>(str.front())))
+        str.remove_prefix(1);
+    while (!str.empty() && isspace(static_cast<unsigned char>(str.back())))
+        str.remove_suffix(1);
+    if (str.empty())
+        return -1;
+
+    size_t colon = str.find(':');
+    if (colon == string_view::npos || colon == 0)
+        return -1;
+
+    size_t hourStart = colon - 1;
+    if (hourStart > 0 && isdigit(static_cast<unsigned char>(str[hourStart - 1])))
+        hourStart--;
+
+    int hour = 0;
+    auto res = from_chars(str.data() + hourStart, str.data() + colon, hour);
+    if (res.ec != errc() || hour < 0 || hour > 23)
+        return -1;
+    return hour;
+}
+
+// PickupDateTime fields, random calendar values
+static vector<string> syntheticTimestamps(size_t count, bool padded)
+{
+    vector<string> out;
+    out.reserve(count);
+
+    Rng rng;
+    char buf[32];
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t r = rng.next();
+        unsigned month = unsigned(r % 12 + 1), day = unsigned((r >> 8) % 28 + 1);
+        unsigned hour = unsigned((r >> 16) % 24), minute = unsigned((r >> 24) % 60);
+        if (padded)
+            snprintf(buf, sizeof(buf), "2024-%02u-%02u %02u:%02u", month, day, hour, minute);
+        else
+            snprintf(buf, sizeof(buf), "2024-%u-%u %u:%02u", month, day, hour, minute);
+        out.emplace_back(buf);
+    }
+    return out;
+}
+
+template <class Fn>
+static long long sumHours(const vector<string>& stamps, Fn&& hourOf)
+{
+    long long sum = 0;
+    for (const string& s : stamps)
+        sum += hourOf(string_view(s));
+    return sum;
+}
+
+static void benchHour(size_t rowCount)
+{
+    printf("hour: PickupDateTime -> hour over %zu timestamps\n", rowCount);
+
+    for (bool padded : { true, false })
+    {
+        vector<string> stamps = syntheticTimestamps(rowCount, padded);
+        printf(" %s\n", padded ? "YYYY-MM-DD HH:MM (fixed layout)" : "YYYY-M-D H:MM (slow path)");
+
+        size_t n = stamps.size();
+        report("legacy extractHour", timeMs([&] { sink = sumHours(stamps, legacyExtractHour); }), n);
+        report("parseHour (validating)", timeMs([&] { sink = sumHours(stamps, parseHour); }), n);
+    }
+}
+
+// ------------------- approx -------------------
+
+// Half the rows from 1000 skewed busy zones, half from a pool of junk
+// zones that are mostly seen once or twice
+static RowSet skewedRows(size_t rowCount)
+{
+    size_t junk = max<size_t>(1, min<size_t>(rowCount / 2, 2000000));
+
+    RowSet set;
+    for (size_t z = 0; z < 1000 + junk; ++z)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), z < 1000 ? "HOT%04zu" : "JUNK%08zu", z);
+        set.zoneNames.emplace_back(buf);
+    }
+
+    Rng rng;
+    set.rows.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i)
+    {
+        uint64_t r = rng.next();
+        uint32_t zone = r & 1 ? uint32_t((r >> 1) % 1000 % (1 + (r >> 20) % 1000))
+                              : uint32_t(1000 + (r >> 1) % junk);
+        set.rows.push_back({ zone, int((r >> 40) % 24) });
+    }
+    return set;
+}
+
+// Zone ids of the k largest counts, count desc then id asc
+static vector<pair<long long, size_t>> topOf(const vector<long long>& counts, size_t k)
+{
+    vector<pair<long long, size_t>> all;
+    for (size_t z = 0; z < counts.size(); ++z)
+        all.push_back({ -counts[z], z });
+    partial_sort(all.begin(), all.begin() + min(k, all.size()), all.end());
+    all.resize(min(k, all.size()));
+    return all;
+}
+
+static void benchApprox(size_t rowCount)
+{
+    printf("approx: exact ZoneStatsTable vs Space-Saving summaries (zones + slots)\n");
+
+    RowSet set = skewedRows(rowCount);
+    size_t n = set.rows.size();
+    printf(" %zu rows, %zu zones (1000 busy, rest junk)\n", n, set.zoneNames.size());
+
+    report("exact", timeMs([&] { sink = recordLayout(set); }), n);
+
+    vector<long long> exact(set.zoneNames.size(), 0);
+    for (const auto& row : set.rows)
+        exact[row.first]++;
+    auto truth = topOf(exact, 10);
+
+    for (size_t capacity : { size_t(256), size_t(4096), size_t(65536) })
+    {
+        TableFeatures features;
+        features.heavyHitters = capacity;
+
+        ZoneStatsTable table(features);
+        double ms = timeMs([&] {
+            table = ZoneStatsTable(features);
+            for (size_t i = 0; i < n; ++i)
+                table.addApprox(set.zone(i), set.rows[i].second);
+            sink = (long long)table.zoneSummary().size();
+        });
+
+        // Accuracy of the reported top 10 against the exact counts
+        vector<long long> estimate(set.zoneNames.size(), 0);
+        map<string, size_t> ids;
+        for (size_t z = 0; z < set.zoneNames.size(); ++z)
+            ids[set.zoneNames[z]] = z;
+        table.zoneSummary().forEach([&](const SpaceSaving::Entry& e) { estimate[ids[e.name]] = e.count; });
+
+        auto reported = topOf(estimate, 10);
+        size_t hits = 0;
+        long long worst = 0;
+        for (const auto& r : reported)
+        {
+            for (const auto& t : truth)
+                hits += r.second == t.second;
+            worst = max(worst, estimate[r.second] - exact[r.second]);
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "space-saving, %zu entries", capacity);
+        report(name, ms, n);
+        printf("  %-34s top-10 recall %zu/10, max overcount %lld (bound %lld)\n", "",
+               hits, worst, table.zoneSummary().minCount());
+    }
+}
+
+// ------------------- dedupe -------------------
+
+// Whole ingest loop over a mapped CSV, one thread
+static long long ingestCsv(const char* path, bool dedupe, long long& duplicates)
+{
+    AnalyzerOptions opts;
+    opts.threads = 1;
+    opts.dedupeTripIds = dedupe;
+
+    TripAnalyzer analyzer(opts);
+    analyzer.ingestFile(path);
+    duplicates = analyzer.duplicateTrips();
+    return analyzer.topZones(1).empty() ? 0 : analyzer.topZones(1)[0].count;
+}
+
+static void benchDedupe(size_t rowCount)
+{
+    printf("dedupe: ingest loop with and without dedupeTripIds (numeric TripIDs)\n");
+
+    string text = syntheticCsv(rowCount);
+
+    // The last tenth of the rows sent a second time
+    string replayed = text;
+    size_t cut = text.size() - text.size() / 10;
+    cut = text.find('\n', cut) + 1;
+    replayed.append(text, cut, string::npos);
+    size_t replayRows = rowCount + size_t(count(text.begin() + cut, text.end(), '\n'));
+
+    const char* feed = "bench_dedupe.csv";
+    const char* replay = "bench_replay.csv";
+    ofstream(feed, ios::binary) << text;
+    ofstream(replay, ios::binary) << replayed;
+
+    long long duplicates = 0;
+    double plain = timeMs([&] { sink = ingestCsv(feed, false, duplicates); });
+    report("plain ingest", plain, rowCount);
+
+    double deduped = timeMs([&] { sink = ingestCsv(feed, true, duplicates); });
+    report("dedupeTripIds, no repeats", deduped, rowCount);
+    printf("  %-34s %+10.2f ns/row over plain (target +50)\n", "", (deduped - plain) * 1e6 / double(rowCount));
+
+    double plainReplay = timeMs([&] { sink = ingestCsv(replay, false, duplicates); });
+    double dedupedReplay = timeMs([&] { sink = ingestCsv(replay, true, duplicates); });
+    remove(feed);
+    remove(replay);
+    report("dedupeTripIds, 10% replayed", dedupedReplay, replayRows);
+    printf("  %-34s %+10.2f ns/row over plain, %lld duplicates dropped\n", "",
+           (dedupedReplay - plainReplay) * 1e6 / double(replayRows), duplicates);
+
+    // The filter alone, on the ids of the replayed feed
+    vector<string> ids;
+    ids.reserve(replayRows);
+    for (size_t pos = text.find('\n') + 1; pos < replayed.size(); pos = replayed.find('\n', pos) + 1)
+        ids.push_back(replayed.substr(pos, replayed.find(',', pos) - pos));
+
+    long long falsePositives = 0;
+    double filterMs = timeMs([&] {
+        TripIdFilter filter;
+        for (const string& id : ids)
+            filter.seen(id);
+        sink = filter.duplicates();
+        falsePositives = filter.falsePositives();
+    });
+    report("TripIdFilter::seen", filterMs, ids.size());
+    printf("  %-34s %lld false positives settled exactly\n", "", falsePositives);
+}
+
+// ------------------- driver -------------------
+
+int main(int argc, char** argv)
+{
+    size_t rows = 10000000;
+    vector<string> sections;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], "--rows=", 7) == 0)
+            rows = strtoull(argv[i] + 7, nullptr, 10);
+        else
+            sections.emplace_back(argv[i]);
+    }
+
+    const map<string, function<void()>> benches = {
+        { "approx", [&] { benchApprox(rows); } },
+        { "dedupe", [&] { benchDedupe(rows); } },
+        { "hash", [&] { benchHash(rows); } },
+        { "hour", [&] { benchHour(rows); } },
+        { "layout", [&] { benchLayout(rows); } },
+        { "scan", [&] { benchScan(rows); } },
+    };
+
+    for (const auto& [name, run] : benches)
+    {
+        bool wanted = sections.empty();
+        for (const string& s : sections)
+            wanted = wanted || s == name;
+
+        if (wanted)
+            run();
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#pragma once // prevents multiple inclusions
+#include <cstdint>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Bit scans used by the SIMD and SWAR scanners, compiler builtins where
+// there are some, plain loops otherwise
+
+// Index of the lowest set bit, x must not be 0
+inline int ctz64(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    int n = 0;
+    while (!(x & 1))
+    {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+inline int ctz32(std::uint32_t x)
+{
+    return ctz64(x);
+}
+
+// Set bits in x
+inline int popcount32(std::uint32_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1)
+        ++n;
+    return n;
+#endif
+}
@@ -0,0 +1,143 @@
+#include "checkpoint.h"
+#include "mapped_file.h"
+#include "snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRIP_HAVE_POSIX_IO
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr char kMagic[8] = { 'T', 'R', 'I', 'P', 'C', 'K', 'P', 'T' };
+constexpr size_t kHeaderBytes = 48;
+constexpr size_t kCheckedBytes = 40;
+
+template <class T>
+void put(string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+T get(const char* p)
+{
+    T value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Writes the whole image and waits until it is on disk
+bool writeDurably(const string& path, const string& image)
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    size_t done = 0;
+    while (done < image.size())
+    {
+        ssize_t wrote = write(fd, image.data() + done, image.size() - done);
+        if (wrote < 0 && errno == EINTR)
+            continue;
+        if (wrote <= 0)
+        {
+            close(fd);
+            return false;
+        }
+        done += static_cast<size_t>(wrote);
+    }
+
+    bool synced = fsync(fd) == 0;
+    return close(fd) == 0 && synced;
+#else
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file.is_open())
+        return false;
+    file.write(image.data(), static_cast<streamsize>(image.size()));
+    return static_cast<bool>(file.flush());
+#endif
+}
+
+} // namespace
+
+bool checkpointSource(const string& path, CheckpointSource& out)
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+
+    out.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+    out.mtimeNs = int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    out.mtimeNs = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+#else
+    (void)path;
+    (void)out;
+    return false;
+#endif
+}
+
+bool writeCheckpointFile(const string& path, const CheckpointSource& source,
+                         uint64_t offset, const ZoneStatsTable& table)
+{
+    string image;
+    image.append(kMagic, sizeof(kMagic));
+    put<uint32_t>(image, kCheckpointVersion);
+    put<uint32_t>(image, 0);
+    put<uint64_t>(image, offset);
+    put<uint64_t>(image, source.size);
+    put<int64_t>(image, source.mtimeNs);
+    put<uint64_t>(image, snapshotChecksum(image.data(), kCheckedBytes));
+    image += encodeSnapshot(table);
+
+    string tmpPath = path + ".tmp";
+    if (!writeDurably(tmpPath, image))
+    {
+        remove(tmpPath.c_str());
+        return false;
+    }
+
+    return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool readCheckpointFile(const string& path, const CheckpointSource& source,
+                        uint64_t& offset, ZoneStatsTable& out)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    const char* data = file.data();
+    if (file.size() < kHeaderBytes || memcmp(data, kMagic, sizeof(kMagic)) != 0)
+        return false;
+    if (get<uint32_t>(data + 8) != kCheckpointVersion)
+        return false;
+    if (get<uint64_t>(data + 40) != snapshotChecksum(data, kCheckedBytes))
+        return false;
+
+    // Input changed since the checkpoint: its offset means nothing now
+    uint64_t savedOffset = get<uint64_t>(data + 16);
+    if (get<uint64_t>(data + 24) != source.size || get<int64_t>(data + 32) != source.mtimeNs ||
+        savedOffset > source.size)
+        return false;
+
+    if (!decodeSnapshot(data + kHeaderBytes, file.size() - kHeaderBytes, out))
+        return false;
+
+    offset = savedOffset;
+    return true;
+}
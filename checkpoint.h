@@ -0,0 +1,40 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "zone_stats.h"
+
+// Identifies the input a checkpoint was taken from
+// A checkpoint is only resumed against the very same file contents
+struct CheckpointSource {
+    std::uint64_t size = 0;
+    std::int64_t mtimeNs = 0;
+};
+
+// Checkpoint file: where ingestion of a file got to, and the aggregates
+// at that point
+//
+// Layout (host byte order):
+//    0  char[8]  magic "TRIPCKPT"
+//    8  u32      format version
+//   12  u32      reserved, 0
+//   16  u64      input offset, every row before it is in the aggregates
+//   24  u64      input size
+//   32  i64      input modification time, ns
+//   40  u64      checksum of bytes 0..39
+//   48  snapshot image of the aggregates (see snapshot.h)
+constexpr std::uint32_t kCheckpointVersion = 1;
+
+// Size and modification time of path, false if it can't be stat'ed
+bool checkpointSource(const std::string& path, CheckpointSource& out);
+
+// Writes path.tmp, flushes it to disk and renames it over path,
+// so the previous checkpoint stays valid until the new one is durable
+bool writeCheckpointFile(const std::string& path, const CheckpointSource& source,
+                         std::uint64_t offset, const ZoneStatsTable& table);
+
+// Loads a checkpoint taken from source
+// Returns false (outputs untouched) if the file is missing, damaged or
+// belongs to a different version of the input
+bool readCheckpointFile(const std::string& path, const CheckpointSource& source,
+                        std::uint64_t& offset, ZoneStatsTable& out);
@@ -0,0 +1,387 @@
+#include "compressed_input.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#ifdef TRIP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef TRIP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+InputCodec detectCodec(const char* data, size_t length)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+    if (length >= 2 && p[0] == 0x1F && p[1] == 0x8B)
+        return InputCodec::Gzip;
+
+    if (length >= 4 && p[0] == 0x28 && p[1] == 0xB5 && p[2] == 0x2F && p[3] == 0xFD)
+        return InputCodec::Zstd;
+
+    return InputCodec::Plain;
+}
+
+bool codecSupported(InputCodec codec)
+{
+    switch (codec)
+    {
+    case InputCodec::Plain:
+        return true;
+    case InputCodec::Gzip:
+#ifdef TRIP_HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    case InputCodec::Zstd:
+#ifdef TRIP_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+DecodedStream::DecodedStream(const char* data, size_t length, InputCodec codec,
+                             unsigned threads, size_t blockBytes)
+    : data(data), length(length), blockBytes(max<size_t>(4096, blockBytes))
+{
+    threads = max(1u, threads);
+
+    // Enough decoded blocks in flight to keep every worker busy
+    window = 2 * size_t(threads) + 2;
+
+    if (!codecSupported(codec) || codec == InputCodec::Plain)
+    {
+        finish(0, codec != InputCodec::Plain);
+        return;
+    }
+
+    if (codec == InputCodec::Gzip)
+    {
+        producersLeft = 1;
+        workers.emplace_back(&DecodedStream::inflateGzip, this);
+        return;
+    }
+
+#ifdef TRIP_HAVE_ZSTD
+    // Frame boundaries come from the frame headers, no decoding needed
+    vector<pair<size_t, size_t>> frames;
+    size_t pos = 0;
+    while (pos < length)
+    {
+        size_t size = ZSTD_findFrameCompressedSize(data + pos, length - pos);
+        if (ZSTD_isError(size) || size == 0)
+            break;
+
+        frames.push_back({ pos, size });
+        pos += size;
+    }
+
+    if (frames.size() > 1 && threads > 1 && pos == length)
+    {
+        zstdFrames(move(frames), threads);
+    }
+    else
+    {
+        producersLeft = 1;
+        workers.emplace_back(&DecodedStream::streamZstd, this);
+    }
+#endif
+}
+
+DecodedStream::~DecodedStream()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        cancelled = true;
+    }
+    changed.notify_all();
+
+    for (auto& w : workers)
+        w.join();
+}
+
+bool DecodedStream::publish(size_t seq, vector<char>&& block)
+{
+    unique_lock<mutex> guard(lock);
+
+    // Backpressure: don't run more than window blocks ahead of the parser
+    changed.wait(guard, [&] { return cancelled || seq < nextSeq + window; });
+    if (cancelled)
+        return false;
+
+    ready.emplace(seq, move(block));
+    changed.notify_all();
+    return true;
+}
+
+void DecodedStream::finish(size_t end, bool error)
+{
+    lock_guard<mutex> guard(lock);
+
+    endSeq = min(endSeq, end);
+    failed = failed || error;
+    changed.notify_all();
+}
+
+size_t DecodedStream::read(char* dst, size_t capacity)
+{
+    while (currentPos == current.size())
+    {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&] {
+            return ready.count(nextSeq) || nextSeq >= endSeq;
+        });
+
+        if (!ready.count(nextSeq))
+            return 0;
+
+        current = move(ready[nextSeq]);
+        ready.erase(nextSeq);
+        currentPos = 0;
+        nextSeq++;
+        changed.notify_all();
+    }
+
+    size_t n = min(capacity, current.size() - currentPos);
+    memcpy(dst, current.data() + currentPos, n);
+    currentPos += n;
+    return n;
+}
+
+bool DecodedStream::ok() const
+{
+    lock_guard<mutex> guard(lock);
+    return !failed;
+}
+
+void DecodedStream::inflateGzip()
+{
+    size_t seq = 0;
+    bool error = false;
+
+#ifdef TRIP_HAVE_ZLIB
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    // 15 + 16: gzip wrapper only, maximum window
+    if (inflateInit2(&zs, 15 + 16) != Z_OK)
+    {
+        finish(0, true);
+        return;
+    }
+
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+    size_t inLeft = length;
+
+    vector<char> block(blockBytes);
+    size_t filled = 0;
+
+    for (;;)
+    {
+        // zlib counts in uInt, feed huge inputs in slices
+        if (zs.avail_in == 0 && inLeft > 0)
+        {
+            zs.next_in = const_cast<unsigned char*>(in);
+            zs.avail_in = static_cast<uInt>(min<size_t>(inLeft, 1u << 30));
+            in += zs.avail_in;
+            inLeft -= zs.avail_in;
+        }
+
+        zs.next_out = reinterpret_cast<unsigned char*>(block.data() + filled);
+        zs.avail_out = static_cast<uInt>(block.size() - filled);
+
+        int rc = inflate(&zs, Z_NO_FLUSH);
+        filled = block.size() - zs.avail_out;
+
+        if (filled == block.size() || rc == Z_STREAM_END || rc != Z_OK)
+        {
+            if (filled > 0)
+            {
+                block.resize(filled);
+                if (!publish(seq++, move(block)))
+                    break;
+                block.assign(blockBytes, 0);
+                filled = 0;
+            }
+        }
+
+        if (rc == Z_STREAM_END)
+        {
+            // Concatenated members (cat a.gz b.gz) decode as one stream
+            size_t rest = zs.avail_in + inLeft;
+            if (rest == 0)
+                break;
+
+            if (detectCodec(reinterpret_cast<const char*>(zs.next_in), rest) != InputCodec::Gzip)
+            {
+                error = true;
+                break;
+            }
+
+            inflateReset(&zs);
+            continue;
+        }
+
+        if (rc != Z_OK && rc != Z_BUF_ERROR)
+        {
+            error = true;
+            break;
+        }
+
+        // Out of input before the member ended: truncated file
+        if (rc == Z_BUF_ERROR && zs.avail_in == 0 && inLeft == 0)
+        {
+            error = true;
+            break;
+        }
+    }
+
+    inflateEnd(&zs);
+#else
+    error = true;
+#endif
+
+    finish(seq, error);
+}
+
+void DecodedStream::streamZstd()
+{
+    size_t seq = 0;
+    bool error = false;
+
+#ifdef TRIP_HAVE_ZSTD
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    if (!dctx)
+    {
+        finish(0, true);
+        return;
+    }
+
+    ZSTD_inBuffer in = { data, length, 0 };
+    size_t lastRc = 0;
+
+    while (in.pos < in.size)
+    {
+        vector<char> block(blockBytes);
+        ZSTD_outBuffer out = { block.data(), block.size(), 0 };
+
+        // Fill one output block, frames follow each other transparently
+        while (out.pos < out.size && in.pos < in.size)
+        {
+            lastRc = ZSTD_decompressStream(dctx, &out, &in);
+            if (ZSTD_isError(lastRc))
+                break;
+        }
+
+        if (ZSTD_isError(lastRc))
+        {
+            error = true;
+            break;
+        }
+
+        block.resize(out.pos);
+        if (!block.empty() && !publish(seq++, move(block)))
+            break;
+    }
+
+    // Flush whatever the decoder still buffers for the last frame
+    while (!error && lastRc != 0)
+    {
+        vector<char> block(blockBytes);
+        ZSTD_outBuffer out = { block.data(), block.size(), 0 };
+        lastRc = ZSTD_decompressStream(dctx, &out, &in);
+        if (ZSTD_isError(lastRc) || out.pos == 0)
+        {
+            // No progress with no input left: truncated frame
+            error = true;
+            break;
+        }
+
+        block.resize(out.pos);
+        if (!publish(seq++, move(block)))
+            break;
+    }
+
+    ZSTD_freeDCtx(dctx);
+#else
+    error = true;
+#endif
+
+    finish(seq, error);
+}
+
+void DecodedStream::zstdFrames(vector<pair<size_t, size_t>> frames, unsigned threads)
+{
+#ifdef TRIP_HAVE_ZSTD
+    size_t frameCount = frames.size();
+    auto next = make_shared<atomic<size_t>>(0);
+    auto shared = make_shared<vector<pair<size_t, size_t>>>(move(frames));
+
+    unsigned workerCount = static_cast<unsigned>(min<size_t>(threads, frameCount));
+    producersLeft = workerCount;
+
+    // Each worker claims the next frame, decodes it whole and publishes
+    // it under the frame's index; read() puts them back in order
+    for (unsigned w = 0; w < workerCount; ++w)
+    {
+        workers.emplace_back([this, next, shared, frameCount] {
+            ZSTD_DCtx* dctx = ZSTD_createDCtx();
+
+            for (size_t i = (*next)++; i < frameCount; i = (*next)++)
+            {
+                const auto& [offset, size] = (*shared)[i];
+                ZSTD_inBuffer in = { data + offset, size, 0 };
+
+                vector<char> block;
+                size_t rc = 1;
+                bool bad = dctx == nullptr;
+
+                while (!bad && rc != 0)
+                {
+                    size_t used = block.size();
+                    block.resize(used + blockBytes);
+                    ZSTD_outBuffer out = { block.data() + used, blockBytes, 0 };
+
+                    rc = ZSTD_decompressStream(dctx, &out, &in);
+                    block.resize(used + out.pos);
+                    bad = ZSTD_isError(rc) || (out.pos == 0 && in.pos == in.size && rc != 0);
+                }
+
+                if (bad)
+                {
+                    finish(i, true);
+                    break;
+                }
+
+                if (!publish(i, move(block)))
+                    break;
+            }
+
+            if (dctx)
+                ZSTD_freeDCtx(dctx);
+
+            bool last;
+            {
+                lock_guard<mutex> guard(lock);
+                last = --producersLeft == 0;
+            }
+            if (last)
+                finish(frameCount, false);
+        });
+    }
+#else
+    (void)frames;
+    (void)threads;
+    finish(0, true);
+#endif
+}
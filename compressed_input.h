@@ -0,0 +1,76 @@
+#pragma once // prevents multiple inclusions
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Container formats recognised from their leading magic bytes
+enum class InputCodec {
+    Plain,
+    Gzip,   // 1F 8B
+    Zstd,   // 28 B5 2F FD
+};
+
+InputCodec detectCodec(const char* data, std::size_t length);
+
+// True when the build links the library behind codec
+// (TRIP_HAVE_ZLIB / TRIP_HAVE_ZSTD, see the Makefile)
+bool codecSupported(InputCodec codec);
+
+// Decompresses an in-memory image on background threads and hands the
+// plain bytes out in order through read(), so the caller's parser runs
+// while the next blocks are still being decoded
+//
+// gzip members are inflated sequentially on one thread. zstd inputs made
+// of several frames (pzstd, zstd --format with -B) are split at frame
+// boundaries and the frames are decompressed in parallel; a single frame
+// streams on one thread. At most `window` decoded blocks are held at once.
+class DecodedStream {
+public:
+    DecodedStream(const char* data, std::size_t length, InputCodec codec,
+                  unsigned threads, std::size_t blockBytes);
+    ~DecodedStream();
+
+    DecodedStream(const DecodedStream&) = delete;
+    DecodedStream& operator=(const DecodedStream&) = delete;
+
+    // Copies up to capacity decoded bytes, 0 at the end of the data
+    std::size_t read(char* dst, std::size_t capacity);
+
+    // False if the input was corrupt or the codec isn't built in
+    // Everything decoded before the damage has still been delivered
+    bool ok() const;
+
+private:
+    // Producer side: blocks up to the window, false when cancelled
+    bool publish(std::size_t seq, std::vector<char>&& block);
+    void finish(std::size_t endSeq, bool failed);
+
+    void inflateGzip();
+    void streamZstd();
+    void zstdFrames(std::vector<std::pair<std::size_t, std::size_t>> frames, unsigned threads);
+
+    const char* data;
+    std::size_t length;
+    std::size_t blockBytes;
+    std::size_t window;
+
+    mutable std::mutex lock;
+    std::condition_variable changed;
+
+    // Decoded blocks by sequence number, consumed strictly in order
+    std::map<std::size_t, std::vector<char>> ready;
+    std::size_t nextSeq = 0;
+    std::size_t endSeq = static_cast<std::size_t>(-1);
+    std::size_t producersLeft = 0;
+    bool failed = false;
+    bool cancelled = false;
+
+    // Block currently being handed out by read()
+    std::vector<char> current;
+    std::size_t currentPos = 0;
+
+    std::vector<std::thread> workers;
+};
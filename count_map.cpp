@@ -0,0 +1,116 @@
+#include "count_map.h"
+#include <algorithm>
+
+using namespace std;
+
+long long CountMap::get(uint64_t key) const
+{
+    if (slots.empty() || key == kEmptyKey)
+        return 0;
+
+    size_t mask = slots.size() - 1;
+    for (size_t i = hashKey(key) & mask;; i = (i + 1) & mask)
+    {
+        const Entry& e = slots[i];
+        if (e.key == key)
+            return e.count;
+        if (e.key == kEmptyKey)
+            return 0;
+    }
+}
+
+void CountMap::merge(const CountMap& other)
+{
+    reserve(used + other.used);
+    other.forEach([this](uint64_t key, long long count) { add(key, count); });
+}
+
+void CountMap::reserve(size_t count)
+{
+    size_t capacity = slots.empty() ? 16 : slots.size();
+    while (count * 2 > capacity)
+        capacity *= 2;
+
+    if (capacity != slots.size())
+        rehash(capacity);
+}
+
+void CountMap::grow()
+{
+    rehash(slots.empty() ? 16 : slots.size() * 2);
+}
+
+void CountMap::rehash(size_t capacity)
+{
+    vector<Entry> old(capacity, Entry{ kEmptyKey, 0 });
+    old.swap(slots);
+    used = 0;
+
+    size_t mask = capacity - 1;
+    for (const Entry& e : old)
+    {
+        if (e.key == kEmptyKey)
+            continue;
+
+        size_t i = hashKey(e.key) & mask;
+        while (slots[i].key != kEmptyKey)
+            i = (i + 1) & mask;
+        slots[i] = e;
+        used++;
+    }
+}
+
+long long DenseCounts::get(int64_t key) const
+{
+    uint64_t i = static_cast<uint64_t>(key - base);
+    if (i < counts.size())
+        return counts[i];
+    return overflow.get(overflowKey(key));
+}
+
+void DenseCounts::addOutside(int64_t key, long long n)
+{
+    if (counts.empty())
+    {
+        // Start with a small window around the first key
+        size_t span = min<size_t>(64, maxSpan);
+        base = key - static_cast<int64_t>(span / 2);
+        counts.assign(span, 0);
+        counts[static_cast<size_t>(key - base)] += n;
+        return;
+    }
+
+    // Widen to cover key, at least doubling so growth stays amortized O(1)
+    int64_t last = base + static_cast<int64_t>(counts.size());
+    int64_t lo = min(base, key);
+    int64_t hi = max(last, key + 1);
+    size_t needed = static_cast<size_t>(hi - lo);
+
+    if (needed > maxSpan)
+    {
+        overflow.add(overflowKey(key), n);
+        return;
+    }
+
+    size_t span = min(maxSpan, max(needed, counts.size() * 2));
+    int64_t newBase = key < base ? hi - static_cast<int64_t>(span) : lo;
+
+    vector<long long> wider(span, 0);
+    copy(counts.begin(), counts.end(), wider.begin() + (base - newBase));
+    counts.swap(wider);
+    base = newBase;
+
+    counts[static_cast<size_t>(key - base)] += n;
+}
+
+void DenseCounts::merge(const DenseCounts& other)
+{
+    if (&other == this)
+    {
+        DenseCounts copy = other;
+        merge(copy);
+        return;
+    }
+
+    other.forEach([this](int64_t key, long long count) { add(key, count); });
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sparse counters keyed by a packed 64-bit key, e.g. (zone id << 32 | x)
+// Open addressing with linear probing over one flat array of
+// {key, count} pairs, so a hit touches a single cache line.
+// Key ~0 marks empty slots and can't be counted.
+class CountMap {
+public:
+    static constexpr std::uint64_t kEmptyKey = ~std::uint64_t(0);
+
+    // Adds n to key's counter, creating it at 0 if it is new
+    void add(std::uint64_t key, long long n = 1)
+    {
+        if ((used + 1) * 2 > slots.size())
+            grow();
+
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hashKey(key) & mask;; i = (i + 1) & mask)
+        {
+            Entry& e = slots[i];
+            if (e.key == key)
+            {
+                e.count += n;
+                return;
+            }
+            if (e.key == kEmptyKey)
+            {
+                e.key = key;
+                e.count = n;
+                used++;
+                return;
+            }
+        }
+    }
+
+    // Counter of key, 0 if it was never added
+    long long get(std::uint64_t key) const;
+
+    void merge(const CountMap& other);
+
+    std::size_t size() const { return used; }
+
+    void reserve(std::size_t count);
+
+    // fn(key, count) for every counter, in no particular order
+    template <class Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (const Entry& e : slots)
+            if (e.key != kEmptyKey)
+                fn(e.key, e.count);
+    }
+
+    // splitmix64 finalizer, packed keys have most entropy in a few bits
+    // Also TripIdFilter's hash of its ids
+    static std::uint64_t hashKey(std::uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ull;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return x;
+    }
+
+private:
+    struct Entry {
+        std::uint64_t key;
+        long long count;
+    };
+
+    void grow();
+    void rehash(std::size_t capacity);
+
+    std::vector<Entry> slots;
+    std::size_t used = 0;
+};
+
+// Counters for integer keys that cluster in a range, e.g. the days or
+// minutes of a trip feed. Keys inside the range are a plain array index;
+// the range widens as keys arrive, up to maxSpan slots, and keys that
+// would widen it further go to a CountMap so a stray date can't blow up
+// the array.
+class DenseCounts {
+public:
+    explicit DenseCounts(std::size_t maxSpan = std::size_t(1) << 16) : maxSpan(maxSpan) {}
+
+    void add(std::int64_t key, long long n = 1)
+    {
+        std::uint64_t i = static_cast<std::uint64_t>(key - base);
+        if (i < counts.size())
+            counts[i] += n;
+        else
+            addOutside(key, n);
+    }
+
+    long long get(std::int64_t key) const;
+
+    void merge(const DenseCounts& other);
+
+    // fn(key, count) for every non-zero counter, array keys in order
+    template <class Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (std::size_t i = 0; i < counts.size(); ++i)
+            if (counts[i] != 0)
+                fn(base + static_cast<std::int64_t>(i), counts[i]);
+
+        overflow.forEach([&](std::uint64_t key, long long count) {
+            fn(fromOverflowKey(key), count);
+        });
+    }
+
+private:
+    // Sign bit flipped, so -1 doesn't collide with CountMap::kEmptyKey
+    static std::uint64_t overflowKey(std::int64_t key) { return static_cast<std::uint64_t>(key) ^ (std::uint64_t(1) << 63); }
+    static std::int64_t fromOverflowKey(std::uint64_t key) { return static_cast<std::int64_t>(key ^ (std::uint64_t(1) << 63)); }
+
+    void addOutside(std::int64_t key, long long n);
+
+    std::size_t maxSpan;
+    std::int64_t base = 0;
+    std::vector<long long> counts;
+    CountMap overflow;
+};
\ No newline at end of file
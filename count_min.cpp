@@ -0,0 +1,134 @@
+#include "count_min.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+constexpr char kMagic[8] = { 'T', 'R', 'I', 'P', 'C', 'M', 'S', 'K' };
+constexpr size_t kHeaderBytes = 40;
+
+template <class T>
+void put(string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+T get(const char* p)
+{
+    T value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth)
+{
+    if (width == 0 || depth == 0)
+        return;
+
+    cols = 1;
+    while (cols < width)
+        cols *= 2;
+    rows = depth;
+    counts.assign(cols * rows, 0);
+}
+
+void CountMinSketch::dimensions(double epsilon, double delta, size_t& width, size_t& depth)
+{
+    width = 0;
+    depth = 0;
+    if (!(epsilon > 0 && epsilon < 1 && delta > 0 && delta < 1))
+        return;
+
+    width = 1;
+    while (double(width) < exp(1.0) / epsilon)
+        width *= 2;
+    depth = static_cast<size_t>(ceil(log(1.0 / delta)));
+    depth = max<size_t>(1, depth);
+}
+
+long long CountMinSketch::estimate(uint64_t hash) const
+{
+    if (rows == 0)
+        return 0;
+
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32) | 1;
+    long long best = LLONG_MAX;
+    for (size_t row = 0; row < rows; ++row, h1 += h2)
+        best = min(best, counts[row * cols + (h1 & (cols - 1))]);
+    return best;
+}
+
+bool CountMinSketch::merge(const CountMinSketch& other)
+{
+    if (other.rows == 0)
+        return true;
+
+    if (rows == 0)
+    {
+        *this = other;
+        return true;
+    }
+
+    if (other.cols != cols || other.rows != rows)
+        return false;
+
+    for (size_t i = 0; i < counts.size(); ++i)
+        counts[i] += other.counts[i];
+    adds += other.adds;
+    return true;
+}
+
+// 0 magic, 8 width, 16 depth, 24 adds, 32 checksum of the counters,
+// 40 counters
+string CountMinSketch::encode() const
+{
+    string out;
+    out.reserve(kHeaderBytes + counts.size() * sizeof(long long));
+    out.append(kMagic, sizeof(kMagic));
+    put<uint64_t>(out, cols);
+    put<uint64_t>(out, rows);
+    put<int64_t>(out, adds);
+    put<uint64_t>(out, 0);  // checksum, patched below
+
+    for (long long c : counts)
+        put<int64_t>(out, c);
+
+    uint64_t sum = snapshotChecksum(out.data() + kHeaderBytes, out.size() - kHeaderBytes);
+    memcpy(&out[32], &sum, sizeof(sum));
+    return out;
+}
+
+bool CountMinSketch::decode(const string& bytes, CountMinSketch& out)
+{
+    const char* data = bytes.data();
+    if (bytes.size() < kHeaderBytes || memcmp(data, kMagic, sizeof(kMagic)) != 0)
+        return false;
+
+    uint64_t width = get<uint64_t>(data + 8);
+    uint64_t depth = get<uint64_t>(data + 16);
+    uint64_t cells = (bytes.size() - kHeaderBytes) / sizeof(long long);
+
+    // Width must be a power of two, and the counters exactly fill the rest
+    if (width == 0 || (width & (width - 1)) != 0 || depth == 0 || depth > cells / width ||
+        width * depth != cells || (bytes.size() - kHeaderBytes) % sizeof(long long) != 0)
+        return false;
+
+    if (snapshotChecksum(data + kHeaderBytes, bytes.size() - kHeaderBytes) != get<uint64_t>(data + 32))
+        return false;
+
+    CountMinSketch sketch(static_cast<size_t>(width), static_cast<size_t>(depth));
+    sketch.adds = get<int64_t>(data + 24);
+    memcpy(sketch.counts.data(), data + kHeaderBytes, cells * sizeof(long long));
+
+    out = move(sketch);
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Count-Min sketch (Cormode, Muthukrishnan) over 64-bit key hashes
+// depth rows of width counters; a key adds to one counter per row and
+// its estimate is the smallest of them. With width = e / epsilon and
+// depth = ln(1 / delta), after N adds every estimate satisfies
+//     true count <= estimate
+//     estimate <= true count + epsilon * N   with probability >= 1 - delta
+// Sketches of the same dimensions merge by adding counters, so the
+// bound holds for the combined input.
+class CountMinSketch {
+public:
+    CountMinSketch() = default;
+    CountMinSketch(std::size_t width, std::size_t depth);
+
+    // Smallest dimensions meeting epsilon and delta, width rounded up to
+    // a power of two. Both 0 when epsilon or delta is out of (0, 1)
+    static void dimensions(double epsilon, double delta, std::size_t& width, std::size_t& depth);
+
+    // Counts n more for the key
+    void add(std::uint64_t hash, long long n = 1)
+    {
+        // Row i uses h1 + i * h2 (Kirsch, Mitzenmacher), one hash per key
+        std::uint64_t h1 = hash;
+        std::uint64_t h2 = (hash >> 32) | 1;
+        for (std::size_t row = 0; row < rows; ++row, h1 += h2)
+            counts[row * cols + (h1 & (cols - 1))] += n;
+        adds += n;
+    }
+
+    long long estimate(std::uint64_t hash) const;
+
+    // Returns false and changes nothing if the dimensions differ
+    bool merge(const CountMinSketch& other);
+
+    std::size_t width() const { return cols; }
+    std::size_t depth() const { return rows; }
+    long long total() const { return adds; }
+    bool empty() const { return rows == 0; }
+
+    // Host byte order image, checksummed like a snapshot
+    std::string encode() const;
+
+    // Returns false (out untouched) on a bad magic, size or checksum
+    static bool decode(const std::string& bytes, CountMinSketch& out);
+
+private:
+    std::size_t cols = 0;
+    std::size_t rows = 0;
+    long long adds = 0;
+    std::vector<long long> counts;  // row-major, rows x cols
+};
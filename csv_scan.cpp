@@ -0,0 +1,107 @@
+#include "csv_scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CSV_SCAN_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+DelimiterMasks scanScalar(const char* block)
+{
+    DelimiterMasks m = { 0, 0 };
+    for (int i = 0; i < 64; ++i)
+    {
+        m.commas |= uint64_t(block[i] == ',') << i;
+        m.newlines |= uint64_t(block[i] == '\n') << i;
+    }
+    return m;
+}
+
+#ifdef CSV_SCAN_X86
+
+__attribute__((target("sse2")))
+DelimiterMasks scanSse2(const char* block)
+{
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    DelimiterMasks m = { 0, 0 };
+    for (int i = 0; i < 4; ++i)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        uint64_t c = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, comma)));
+        uint64_t n = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        m.commas |= c << (16 * i);
+        m.newlines |= n << (16 * i);
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+DelimiterMasks scanAvx2(const char* block)
+{
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+
+    uint64_t cLo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, comma)));
+    uint64_t cHi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, comma)));
+    uint64_t nLo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline)));
+    uint64_t nHi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline)));
+
+    return { cLo | (cHi << 32), nLo | (nHi << 32) };
+}
+
+#endif
+
+const BlockScanKernel* kernels(size_t& count)
+{
+#ifdef CSV_SCAN_X86
+    static const BlockScanKernel table[] = {
+        { "avx2", scanAvx2, __builtin_cpu_supports("avx2") != 0 },
+        { "sse2", scanSse2, __builtin_cpu_supports("sse2") != 0 },
+        { "scalar", scanScalar, true },
+    };
+#else
+    static const BlockScanKernel table[] = {
+        { "scalar", scanScalar, true },
+    };
+#endif
+    count = sizeof(table) / sizeof(table[0]);
+    return table;
+}
+
+const BlockScanKernel& bestKernel()
+{
+    static const BlockScanKernel& best = [] () -> const BlockScanKernel& {
+        size_t count;
+        const BlockScanKernel* table = kernels(count);
+        for (size_t i = 0; i < count; ++i)
+            if (table[i].supported)
+                return table[i];
+        return table[count - 1];
+    }();
+    return best;
+}
+
+} // namespace
+
+BlockScanFn blockScanner()
+{
+    return bestKernel().scan;
+}
+
+const char* blockScannerName()
+{
+    return bestKernel().name;
+}
+
+const BlockScanKernel* blockScanKernels(size_t& count)
+{
+    return kernels(count);
+}
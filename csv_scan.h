@@ -0,0 +1,94 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "bit_ops.h"
+
+// Delimiter bitmaps for one 64-byte block, bit i describes byte i
+struct DelimiterMasks {
+    std::uint64_t commas;
+    std::uint64_t newlines;
+};
+
+// Scans exactly 64 readable bytes
+using BlockScanFn = DelimiterMasks (*)(const char* block);
+
+// Fastest kernel this CPU supports: AVX2, SSE2 or portable scalar
+// Picked once from cpuid on first use
+BlockScanFn blockScanner();
+
+// "avx2", "sse2" or "scalar"
+const char* blockScannerName();
+
+// Every scanner, fastest first, so tests and benchmarks can pin one
+struct BlockScanKernel {
+    const char* name;
+    BlockScanFn scan;
+    bool supported;
+};
+const BlockScanKernel* blockScanKernels(std::size_t& count);
+
+// Only the first five commas matter: they bound the six schema fields
+constexpr int kTrackedCommas = 5;
+
+// Splits [begin, end) on '\n' like getline does and calls
+//   onRow(rowBegin, rowLength, commaOffsets, commaCount)
+// for every row, commaOffsets are relative to rowBegin and commaCount
+// stops at kTrackedCommas. A last row without a newline is still emitted.
+template <class OnRow>
+void scanRows(const char* begin, const char* end, BlockScanFn scan, OnRow&& onRow)
+{
+    const char* rowStart = begin;
+    std::size_t commas[kTrackedCommas];
+    int commaCount = 0;
+
+    auto consume = [&](const char* base, DelimiterMasks m, std::uint64_t valid) {
+        std::uint64_t newlines = m.newlines & valid;
+        std::uint64_t bits = (m.commas & valid) | newlines;
+
+        while (bits)
+        {
+            int i = ctz64(bits);
+            const char* p = base + i;
+
+            if ((newlines >> i) & 1)
+            {
+                onRow(rowStart, static_cast<std::size_t>(p - rowStart), commas, commaCount);
+                rowStart = p + 1;
+                commaCount = 0;
+            }
+            else if (commaCount < kTrackedCommas)
+            {
+                commas[commaCount++] = static_cast<std::size_t>(p - rowStart);
+            }
+
+            bits &= bits - 1;
+        }
+    };
+
+    const char* pos = begin;
+    while (end - pos >= 64)
+    {
+        consume(pos, scan(pos), ~std::uint64_t(0));
+        pos += 64;
+    }
+
+    // Tail: scan a zero padded copy, offsets still point into the source
+    std::size_t rest = static_cast<std::size_t>(end - pos);
+    if (rest > 0)
+    {
+        alignas(64) char block[64] = {};
+        std::memcpy(block, pos, rest);
+        consume(pos, scan(block), (std::uint64_t(1) << rest) - 1);
+    }
+
+    if (rowStart < end)
+        onRow(rowStart, static_cast<std::size_t>(end - rowStart), commas, commaCount);
+}
+
+template <class OnRow>
+void scanRows(const char* begin, const char* end, OnRow&& onRow)
+{
+    static const BlockScanFn scan = blockScanner();
+    scanRows(begin, end, scan, onRow);
+}
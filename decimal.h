@@ -0,0 +1,125 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "bit_ops.h"
+#include "timestamp.h"
+
+// Fixed-point values carry three decimal places: a DistanceKm of "12.5"
+// is 12500 (metres), a FareAmount of "7.25" is 7250
+constexpr long long kDecimalScale = 1000;
+
+// Strict non-negative decimal: digits, optionally '.' and more digits,
+// surrounded by optional blanks. No sign, exponent, thousands separator,
+// leading or trailing '.', so no strtod and no locale.
+// Fraction digits past the third are checked but truncated.
+// Returns false and leaves out alone for anything else
+inline bool parseDecimal(std::string_view text, long long& out)
+{
+    const char* p = text.data();
+    const char* end = p + text.size();
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        --end;
+
+    // 12 integer digits keep the scaled value and any realistic sum of
+    // them far below 2^63
+    long long whole = 0;
+    const char* digits = p;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10)
+    {
+        whole = whole * 10 + (*p - '0');
+        ++p;
+    }
+    if (p == digits || p - digits > 12)
+        return false;
+
+    long long fraction = 0;
+    if (p < end && *p == '.')
+    {
+        ++p;
+        int places = 0;
+        for (; p < end && static_cast<unsigned>(*p - '0') < 10; ++p, ++places)
+        {
+            if (places < 3)
+                fraction = fraction * 10 + (*p - '0');
+        }
+        if (places == 0)
+            return false;
+        for (; places < 3; ++places)
+            fraction *= 10;
+    }
+
+    if (p != end)
+        return false;
+
+    out = whole * kDecimalScale + fraction;
+    return true;
+}
+
+namespace decimal_detail {
+
+constexpr std::uint64_t kOnes = 0x0101010101010101ull;
+
+// Value of the digit string in the high bytes of word, first digit
+// lowest, zero bytes below it count as leading zeros (D. Lemire's
+// eight-digit SWAR conversion, three multiplies)
+inline std::uint64_t eightDigits(std::uint64_t word)
+{
+    word = (word & (kOnes * 0x0F)) * 2561 >> 8;
+    word = (word & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    return (word & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32;
+}
+
+} // namespace decimal_detail
+
+// The common short case, at most 5 integer and 3 fraction digits and no
+// blanks: one 8-byte load ending at end, so the 8 bytes before end must
+// be readable. Returns false for anything it can't decide on its own
+inline bool parseDecimalFixed(const char* end, std::size_t n, long long& out)
+{
+    using namespace decimal_detail;
+
+    if (n - 1 >= 8)
+        return false;
+
+    // Field in the low n bytes, first character lowest
+    std::uint64_t word = timestamp_detail::loadWord(end - 8) >> (8 * (8 - n));
+    std::uint64_t live = ~std::uint64_t(0) >> (8 * (8 - n));
+
+    // First '.', exact for the lowest zero byte of word ^ "........"
+    std::uint64_t x = word ^ (kOnes * '.');
+    std::uint64_t dots = (x - kOnes) & ~x & (kOnes * 0x80) & live;
+    unsigned whole = dots ? static_cast<unsigned>(ctz64(dots)) / 8 : static_cast<unsigned>(n);
+    unsigned places = dots ? static_cast<unsigned>(n) - 1 - whole : 0;
+    if (whole - 1 >= 5 || places > 3 || (dots && places == 0))
+        return false;
+
+    // Drop the '.', the digits close up
+    std::uint64_t below = (std::uint64_t(1) << (8 * whole)) - 1;
+    std::uint64_t digits = (word & below) | ((word >> 8) & ~below);
+
+    // Same digit test as the timestamp layouts, on the used bytes only
+    unsigned used = whole + places;
+    std::uint64_t usedMask = ~std::uint64_t(0) >> (8 * (8 - used));
+    std::uint64_t mismatch = (((digits & (kOnes * 0xF0)) ^ (kOnes * 0x30)) |
+                              (((digits + kOnes * 0x06) & (kOnes * 0xF0)) ^ (kOnes * 0x30))) & usedMask;
+    if (mismatch != 0)
+        return false;
+
+    // whole + 3 digits, missing fraction digits are zero bytes
+    unsigned width = whole + 3;
+    out = static_cast<long long>(eightDigits((digits & usedMask) << (8 * (8 - width))));
+    return true;
+}
+
+// parseDecimal of [begin, end), a field of the row starting at rowBegin
+inline bool parseDecimalField(const char* rowBegin, const char* begin, const char* end, long long& out)
+{
+    const char* last = end > begin && end[-1] == '\r' ? end - 1 : end;
+    if (last - rowBegin >= 8 && parseDecimalFixed(last, static_cast<std::size_t>(last - begin), out))
+        return true;
+    return parseDecimal(std::string_view(begin, static_cast<std::size_t>(end - begin)), out);
+}
@@ -1,6 +1,7 @@
 #include "analyzer.h"
 #include <iostream>
 #include <chrono>
+#include <string>
 
 static void printZones(const std::vector<ZoneCount>& v) {
     std::cout << "TOP_ZONES\n";
@@ -14,11 +15,18 @@ static void printSlots(const std::vector<SlotCount>& v) {
         std::cout << x.zone << "," << x.hour << "," << x.count << "\n";
 }
 
-int main() {
+// Usage: ./app [file.csv | -]
+// Defaults to SmallTrips.csv, "-" reads CSV rows from stdin
+int main(int argc, char** argv) {
+    std::string input = argc > 1 ? argv[1] : "SmallTrips.csv";
+
     auto t0 = std::chrono::high_resolution_clock::now();
 
     TripAnalyzer analyzer;
-    analyzer.ingestFile("SmallTrips.csv");
+    if (input == "-")
+        analyzer.ingestStream(std::cin);
+    else
+        analyzer.ingestFile(input);
 
     printZones(analyzer.topZones(10));
     printSlots(analyzer.topBusySlots(10));
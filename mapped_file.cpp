@@ -0,0 +1,58 @@
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRIP_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+MappedFile::~MappedFile()
+{
+#ifdef TRIP_HAVE_MMAP
+    if (base)
+        munmap(const_cast<char*>(base), length);
+#endif
+}
+
+bool MappedFile::open(const string& path, bool sequential)
+{
+#ifdef TRIP_HAVE_MMAP
+    if (base)
+        return false;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    // Only regular files have a trustworthy size,
+    // pipes and /proc entries report 0 and go through the stream path
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t bytes = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    if (sequential)
+        madvise(mapped, bytes, MADV_SEQUENTIAL);
+
+    base = static_cast<const char*>(mapped);
+    length = bytes;
+    return true;
+#else
+    (void)path;
+    (void)sequential;
+    return false;
+#endif
+}
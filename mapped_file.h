@@ -0,0 +1,25 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a regular file, unmapped on destruction
+// open() fails for anything without a trustworthy size: pipes, /proc
+// entries, directories, empty files, or platforms without mmap
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // sequential: the caller reads front to back exactly once
+    bool open(const std::string& path, bool sequential = true);
+
+    const char* data() const { return base; }
+    std::size_t size() const { return length; }
+
+private:
+    const char* base = nullptr;
+    std::size_t length = 0;
+};
@@ -0,0 +1,205 @@
+#include "snapshot.h"
+#include "bit_ops.h"
+#include "mapped_file.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+
+constexpr char kMagic[8] = { 'T', 'R', 'I', 'P', 'S', 'N', 'A', 'P' };
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr size_t kHeaderBytes = 48;
+
+// Zero bytes that round n up to a multiple of 8
+inline size_t padding(size_t n)
+{
+    return (8 - n % 8) % 8;
+}
+
+template <class T>
+void put(string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+T get(const char* p)
+{
+    T value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// 64-bit multiply-rotate hash over 8-byte words
+uint64_t checksum(const char* data, size_t length)
+{
+    const uint64_t k1 = 0x9E3779B97F4A7C15ull;
+    const uint64_t k2 = 0xC2B2AE3D27D4EB4Full;
+    uint64_t h = length * k1;
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        h ^= get<uint64_t>(data + i) * k2;
+        h = (h << 31) | (h >> 33);
+        h *= k1;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, length - i);
+    h ^= tail * k2;
+
+    h ^= h >> 33;
+    h *= k2;
+    h ^= h >> 29;
+    return h;
+}
+
+} // namespace
+
+string encodeSnapshot(const ZoneStatsTable& table)
+{
+    const ZoneDictionary& zones = table.zones();
+    uint64_t count = table.size();
+
+    string out;
+    out.reserve(kHeaderBytes + count * 32);
+
+    out.append(kMagic, sizeof(kMagic));
+    put<uint32_t>(out, kSnapshotVersion);
+    put<uint32_t>(out, kByteOrderMark);
+    put<uint32_t>(out, 24);
+    put<uint32_t>(out, 0);
+    put<uint64_t>(out, count);
+    put<uint64_t>(out, 0); // payload bytes, patched below
+    put<uint64_t>(out, 0); // checksum, patched below
+
+    for (uint32_t id = 0; id < count; ++id)
+    {
+        const ZoneStats& s = table.stats(id);
+        const string& name = zones.name(id);
+
+        uint32_t mask = 0;
+        for (int h = 0; h < 24; ++h)
+            if (s.hours[h] != 0)
+                mask |= 1u << h;
+
+        put<uint32_t>(out, mask);
+        put<uint32_t>(out, static_cast<uint32_t>(name.size()));
+        for (int h = 0; h < 24; ++h)
+            if (mask & (1u << h))
+                put<int64_t>(out, s.hours[h]);
+
+        out += name;
+        out.append(padding(name.size()), '\0');
+    }
+
+    uint64_t payload = out.size() - kHeaderBytes;
+    uint64_t sum = checksum(out.data() + kHeaderBytes, payload);
+    memcpy(&out[32], &payload, sizeof(payload));
+    memcpy(&out[40], &sum, sizeof(sum));
+    return out;
+}
+
+bool decodeSnapshot(const char* data, size_t length, ZoneStatsTable& out)
+{
+    if (length < kHeaderBytes || memcmp(data, kMagic, sizeof(kMagic)) != 0)
+        return false;
+
+    if (get<uint32_t>(data + 8) != kSnapshotVersion ||
+        get<uint32_t>(data + 12) != kByteOrderMark ||
+        get<uint32_t>(data + 16) != 24 ||
+        get<uint32_t>(data + 20) != 0)
+        return false;
+
+    uint64_t count = get<uint64_t>(data + 24);
+    uint64_t payload = get<uint64_t>(data + 32);
+
+    // Every record takes at least 8 bytes, bounds a hostile count
+    if (payload != length - kHeaderBytes || count > payload / 8)
+        return false;
+
+    const char* pos = data + kHeaderBytes;
+    const char* end = data + length;
+    if (checksum(pos, payload) != get<uint64_t>(data + 40))
+        return false;
+
+    ZoneStatsTable table;
+    table.reserve(count);
+
+    for (uint64_t id = 0; id < count; ++id)
+    {
+        if (end - pos < 8)
+            return false;
+
+        uint32_t mask = get<uint32_t>(pos);
+        uint32_t nameBytes = get<uint32_t>(pos + 4);
+        pos += 8;
+
+        size_t countBytes = 8 * static_cast<size_t>(popcount32(mask));
+        size_t nameSpan = nameBytes + padding(nameBytes);
+        if ((mask >> 24) != 0 || nameBytes == 0 ||
+            static_cast<size_t>(end - pos) < countBytes + nameSpan)
+            return false;
+
+        ZoneStats s;
+        for (int h = 0; h < 24; ++h)
+        {
+            if (mask & (1u << h))
+            {
+                s.hours[h] = get<int64_t>(pos);
+                s.total += s.hours[h];
+                pos += 8;
+            }
+        }
+
+        table.addStats(string_view(pos, nameBytes), s);
+        pos += nameSpan;
+    }
+
+    if (pos != end)
+        return false;
+
+    out = move(table);
+    return true;
+}
+
+bool writeSnapshotFile(const string& path, const ZoneStatsTable& table)
+{
+    string image = encodeSnapshot(table);
+    string tmpPath = path + ".tmp";
+
+    {
+        ofstream file(tmpPath, ios::binary | ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        file.write(image.data(), static_cast<streamsize>(image.size()));
+        if (!file.flush())
+        {
+            file.close();
+            remove(tmpPath.c_str());
+            return false;
+        }
+    }
+
+    return rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool readSnapshotFile(const string& path, ZoneStatsTable& out)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    return decodeSnapshot(file.data(), file.size(), out);
+}
+
+uint64_t snapshotChecksum(const char* data, size_t length)
+{
+    return checksum(data, length);
+}
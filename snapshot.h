@@ -0,0 +1,43 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "zone_stats.h"
+
+// Binary image of a ZoneStatsTable
+//
+// Layout (host byte order, every field 8-byte aligned so a mapped file
+// is decoded in place):
+//    0  char[8]  magic "TRIPSNAP"
+//    8  u32      format version
+//   12  u32      byte-order mark 0x01020304
+//   16  u32      hour buckets per zone (24)
+//   20  u32      reserved, 0
+//   24  u64      zone count N
+//   32  u64      payload bytes
+//   40  u64      payload checksum
+//   48  payload: N records in zone id order, each
+//       u32        mask of hours with a non-zero count
+//       u32        zone name length
+//       i64 x popcount(mask)  those hour counts, ascending hour
+//       name bytes, zero padded to a multiple of 8
+// Zone totals are the sum of their hours and aren't stored, so a zone
+// seen in one hour costs 16 bytes plus its name
+constexpr std::uint32_t kSnapshotVersion = 1;
+
+std::string encodeSnapshot(const ZoneStatsTable& table);
+
+// 64-bit checksum of the payload, also used by checkpoint headers
+std::uint64_t snapshotChecksum(const char* data, std::size_t length);
+
+// Rebuilds a table from an encoded image
+// Returns false (out untouched) on a bad magic, version, byte order,
+// size or checksum
+bool decodeSnapshot(const char* data, std::size_t length, ZoneStatsTable& out);
+
+// Writes path.tmp and renames it over path, so a crash never leaves
+// a half written snapshot behind
+bool writeSnapshotFile(const std::string& path, const ZoneStatsTable& table);
+
+// Maps the file and decodes it in place
+bool readSnapshotFile(const std::string& path, ZoneStatsTable& out);
@@ -0,0 +1,256 @@
+#include "space_saving.h"
+#include "zone_dictionary.h"
+#include <algorithm>
+
+using namespace std;
+
+SpaceSaving::SpaceSaving(size_t capacity)
+{
+    if (capacity == 0)
+        return;
+
+    vector<Entry> none;
+    entries.resize(capacity, Entry{ string(), 0, 0, 0 });
+    rebuild(none);
+}
+
+uint64_t SpaceSaving::hashKey(string_view name, int tag)
+{
+    uint64_t h = ZoneDictionary::hashKey(name) ^ (uint64_t(uint32_t(tag)) * 0x9E3779B97F4A7C15ull);
+    h ^= h >> 32;
+    return h;
+}
+
+uint32_t SpaceSaving::find(string_view name, int tag, uint64_t hash) const
+{
+    if (index.empty())
+        return npos;
+
+    size_t mask = index.size() - 1;
+    for (size_t i = hash & mask; index[i] != 0; i = (i + 1) & mask)
+    {
+        uint32_t e = index[i] - 1;
+        if (hashes[e] == hash && entries[e].tag == tag && entries[e].name == name)
+            return e;
+    }
+    return npos;
+}
+
+void SpaceSaving::link(uint32_t entry)
+{
+    size_t mask = index.size() - 1;
+    size_t i = hashes[entry] & mask;
+    while (index[i] != 0)
+        i = (i + 1) & mask;
+    index[i] = entry + 1;
+}
+
+void SpaceSaving::unlink(uint32_t entry)
+{
+    size_t mask = index.size() - 1;
+    size_t hole = hashes[entry] & mask;
+    while (index[hole] != entry + 1)
+        hole = (hole + 1) & mask;
+
+    // Pull later keys of the probe run back so lookups never stop early
+    for (size_t j = (hole + 1) & mask; index[j] != 0; j = (j + 1) & mask)
+    {
+        size_t home = hashes[index[j] - 1] & mask;
+        bool stays = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (!stays)
+        {
+            index[hole] = index[j];
+            hole = j;
+        }
+    }
+    index[hole] = 0;
+}
+
+uint32_t SpaceSaving::newBucket(long long count, uint32_t begin, uint32_t end)
+{
+    if (freeBuckets.empty())
+    {
+        buckets.push_back({ count, begin, end });
+        return static_cast<uint32_t>(buckets.size() - 1);
+    }
+
+    uint32_t b = freeBuckets.back();
+    freeBuckets.pop_back();
+    buckets[b] = { count, begin, end };
+    return b;
+}
+
+void SpaceSaving::increment(uint32_t entry)
+{
+    uint32_t from = bucketOf[entry];
+    long long count = buckets[from].count + 1;
+
+    // Swap entry to the end of its bucket, then shrink the bucket by one
+    uint32_t last = buckets[from].end - 1;
+    uint32_t other = order[last];
+    order[position[entry]] = other;
+    position[other] = position[entry];
+    order[last] = entry;
+    position[entry] = last;
+    buckets[from].end = last;
+
+    // The next bucket starts right after, join it if it counts one more
+    uint32_t next = last + 1 < order.size() ? bucketOf[order[last + 1]] : npos;
+    if (next != npos && buckets[next].count == count)
+    {
+        buckets[next].begin = last;
+        bucketOf[entry] = next;
+    }
+    else
+    {
+        bucketOf[entry] = newBucket(count, last, last + 1);
+    }
+
+    if (buckets[from].begin == buckets[from].end)
+        freeBuckets.push_back(from);
+
+    entries[entry].count = count;
+}
+
+void SpaceSaving::add(string_view name, int tag)
+{
+    if (entries.empty())
+        return;
+
+    rows++;
+    uint64_t hash = hashKey(name, tag);
+
+    uint32_t e = find(name, tag, hash);
+    if (e == npos)
+    {
+        // The smallest counter is handed over, its count is the error
+        e = order[0];
+        Entry& victim = entries[e];
+        if (victim.count > 0)
+            unlink(e);
+        else
+            used++;
+
+        victim.name.assign(name.data(), name.size());
+        victim.tag = tag;
+        victim.error = victim.count;
+        hashes[e] = hash;
+        link(e);
+    }
+
+    increment(e);
+}
+
+long long SpaceSaving::minCount() const
+{
+    if (entries.empty())
+        return 0;
+    return entries[order[0]].count;
+}
+
+long long SpaceSaving::estimate(string_view name, int tag) const
+{
+    uint32_t e = find(name, tag, hashKey(name, tag));
+    return e == npos ? minCount() : entries[e].count;
+}
+
+void SpaceSaving::merge(const SpaceSaving& other)
+{
+    if (&other == this)
+    {
+        SpaceSaving copy = other;
+        merge(copy);
+        return;
+    }
+
+    if (other.rows == 0)
+        return;
+
+    if (entries.empty())
+    {
+        *this = other;
+        return;
+    }
+
+    long long mine = minCount();
+    long long theirs = other.minCount();
+
+    vector<Entry> all;
+    all.reserve(used + other.used);
+
+    for (uint32_t e = 0; e < entries.size(); ++e)
+    {
+        if (entries[e].count == 0)
+            continue;
+
+        Entry merged = entries[e];
+        uint32_t o = other.find(merged.name, merged.tag, hashes[e]);
+        merged.count += o != npos ? other.entries[o].count : theirs;
+        merged.error += o != npos ? other.entries[o].error : theirs;
+        all.push_back(move(merged));
+    }
+
+    for (uint32_t o = 0; o < other.entries.size(); ++o)
+    {
+        const Entry& from = other.entries[o];
+        if (from.count > 0 && find(from.name, from.tag, other.hashes[o]) == npos)
+            all.push_back({ from.name, from.tag, from.count + mine, from.error + mine });
+    }
+
+    rows += other.rows;
+    rebuild(all);
+}
+
+void SpaceSaving::rebuild(vector<Entry>& all)
+{
+    size_t capacity = entries.size();
+
+    // Largest counts win, names and tags break ties so merges are
+    // reproducible
+    sort(all.begin(), all.end(), [](const Entry& a, const Entry& b) {
+        if (a.count != b.count)
+            return a.count > b.count;
+        if (a.name != b.name)
+            return a.name < b.name;
+        return a.tag < b.tag;
+    });
+    if (all.size() > capacity)
+        all.resize(capacity);
+
+    used = all.size();
+    all.resize(capacity, Entry{ string(), 0, 0, 0 });
+
+    size_t slots = 16;
+    while (slots < capacity * 2)
+        slots *= 2;
+    index.assign(slots, 0);
+
+    entries.clear();
+    hashes.clear();
+    position.clear();
+    bucketOf.clear();
+    order.clear();
+    buckets.clear();
+    freeBuckets.clear();
+
+    // Ascending counts, so the unused entries come first
+    for (size_t i = capacity; i-- > 0;)
+    {
+        uint32_t e = static_cast<uint32_t>(entries.size());
+        uint32_t pos = static_cast<uint32_t>(order.size());
+        long long count = all[i].count;
+
+        entries.push_back(move(all[i]));
+        hashes.push_back(hashKey(entries[e].name, entries[e].tag));
+        position.push_back(pos);
+        order.push_back(e);
+
+        if (buckets.empty() || buckets.back().count != count)
+            buckets.push_back({ count, pos, pos });
+        buckets.back().end = pos + 1;
+        bucketOf.push_back(static_cast<uint32_t>(buckets.size() - 1));
+
+        if (count > 0)
+            link(e);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Space-Saving heavy hitters summary (Metwally, Agrawal, El Abbadi)
+// Monitors at most capacity (name, tag) keys, so memory is set by the
+// capacity and not by the input. A key that isn't monitored takes the
+// place of the one with the smallest count and inherits that count as
+// its error. For every monitored key
+//     true count <= count <= true count + error,  error <= minCount()
+// and every key whose true count is above minCount() is monitored.
+// minCount() never exceeds total() / capacity.
+class SpaceSaving {
+public:
+    struct Entry {
+        std::string name;
+        int tag;
+        long long count;
+        long long error;
+    };
+
+    explicit SpaceSaving(std::size_t capacity = 0);
+
+    // Counts one more for (name, tag), O(1), a no-op with capacity 0
+    void add(std::string_view name, int tag);
+
+    // Mergeable summaries (Agarwal et al.): a key missing on one side is
+    // taken to have that side's minCount(), then the largest capacity
+    // counts are kept. The bounds above still hold for the combined input
+    void merge(const SpaceSaving& other);
+
+    // Smallest monitored count once the summary is full, 0 before
+    long long minCount() const;
+
+    // Upper estimate of (name, tag): its count if monitored, minCount()
+    // otherwise, never below the true count
+    long long estimate(std::string_view name, int tag) const;
+
+    long long total() const { return rows; }
+    std::size_t capacity() const { return entries.size(); }
+    std::size_t size() const { return used; }
+
+    // fn(entry) for every monitored key, in no particular order
+    template <class Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (const Entry& e : entries)
+            if (e.count > 0)
+                fn(e);
+    }
+
+private:
+    static constexpr std::uint32_t npos = UINT32_MAX;
+
+    // Entries with the same count, order[begin, end)
+    struct Bucket {
+        long long count;
+        std::uint32_t begin;
+        std::uint32_t end;
+    };
+
+    static std::uint64_t hashKey(std::string_view name, int tag);
+
+    std::uint32_t find(std::string_view name, int tag, std::uint64_t hash) const;
+
+    // Key -> entry index, linear probing with backward-shift deletion
+    void link(std::uint32_t entry);
+    void unlink(std::uint32_t entry);
+
+    // Moves entry from its bucket to the one counting one more
+    void increment(std::uint32_t entry);
+
+    std::uint32_t newBucket(long long count, std::uint32_t begin, std::uint32_t end);
+
+    // Replaces the contents with all, keeping the capacity largest
+    void rebuild(std::vector<Entry>& all);
+
+    long long rows = 0;
+    std::size_t used = 0;
+
+    // Unused entries have count 0 and sit in the lowest bucket, so a new
+    // key and an evicted one take the same path
+    std::vector<Entry> entries;
+    std::vector<std::uint64_t> hashes;     // per entry
+    std::vector<std::uint32_t> position;   // per entry, index into order
+    std::vector<std::uint32_t> bucketOf;   // per entry
+
+    // Entry indices by ascending count, each count one contiguous bucket
+    std::vector<std::uint32_t> order;
+    std::vector<Bucket> buckets;
+    std::vector<std::uint32_t> freeBuckets;
+
+    // entry index + 1, 0 marks an empty slot; twice the capacity, rounded
+    // up to a power of two
+    std::vector<std::uint32_t> index;
+};
@@ -0,0 +1,201 @@
+#include "tail_follow.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRIP_HAVE_POSIX_IO
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#define TRIP_HAVE_INOTIFY
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+using namespace std;
+
+FileFollower::~FileFollower()
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    if (fd >= 0)
+        close(fd);
+    if (notifyFd >= 0)
+        close(notifyFd);
+#endif
+}
+
+bool FileFollower::open(const string& filePath, size_t blockBytes)
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    if (fd >= 0)
+        return false;
+
+    fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    path = filePath;
+    buffer.resize(max<size_t>(4096, blockBytes));
+
+#ifdef TRIP_HAVE_INOTIFY
+    // Without a watch wait() falls back to polling the size
+    notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd >= 0 &&
+        inotify_add_watch(notifyFd, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF) < 0)
+    {
+        close(notifyFd);
+        notifyFd = -1;
+    }
+#endif
+    return true;
+#else
+    (void)filePath;
+    (void)blockBytes;
+    return false;
+#endif
+}
+
+uint64_t FileFollower::currentSize() const
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0)
+        return static_cast<uint64_t>(st.st_size);
+#endif
+    return 0;
+}
+
+void FileFollower::wait(int timeoutMs)
+{
+    if (timeoutMs <= 0)
+        return;
+
+#ifdef TRIP_HAVE_INOTIFY
+    if (notifyFd >= 0)
+    {
+        pollfd pfd = { notifyFd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeoutMs) > 0)
+        {
+            // Drain the events, readNew() looks at the file itself
+            char events[4096];
+            while (read(notifyFd, events, sizeof(events)) > 0)
+            {
+            }
+        }
+        return;
+    }
+#endif
+
+    // Polling fallback: wake as soon as the size moves
+    using namespace chrono;
+    auto deadline = steady_clock::now() + milliseconds(timeoutMs);
+    uint64_t start = currentSize();
+    while (steady_clock::now() < deadline && currentSize() == start)
+        this_thread::sleep_for(milliseconds(5));
+}
+
+// Log rotation: the path now names a different file
+// Only switches once everything written to the old one has been read
+bool FileFollower::reopenIfReplaced()
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    struct stat byPath, byFd;
+    if (stat(path.c_str(), &byPath) != 0 || fstat(fd, &byFd) != 0)
+        return false;
+    if (byPath.st_ino == byFd.st_ino && byPath.st_dev == byFd.st_dev)
+        return false;
+
+    int fresh = ::open(path.c_str(), O_RDONLY);
+    if (fresh < 0)
+        return false;
+
+    // A row the old file never finished is dropped with it
+    close(fd);
+    fd = fresh;
+    readPos = 0;
+    carry.clear();
+
+#ifdef TRIP_HAVE_INOTIFY
+    if (notifyFd >= 0)
+        inotify_add_watch(notifyFd, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+#endif
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t FileFollower::readNew(const RowsFn& onRows)
+{
+#ifdef TRIP_HAVE_POSIX_IO
+    if (fd < 0)
+        return 0;
+
+    size_t consumed = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        // Truncated in place: whatever is there now is new data
+        if (currentSize() < readPos)
+        {
+            readPos = 0;
+            carry.clear();
+        }
+
+        for (;;)
+        {
+            ssize_t got = pread(fd, buffer.data(), buffer.size(), static_cast<off_t>(readPos));
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                break;
+
+            readPos += static_cast<uint64_t>(got);
+            const char* begin = buffer.data();
+            const char* end = begin + got;
+
+            const char* lastNl = end;
+            while (lastNl > begin && lastNl[-1] != '\n')
+                --lastNl;
+
+            if (lastNl == begin)
+            {
+                carry.append(begin, end);
+                continue;
+            }
+
+            // Finish the row held back from last time, then the whole rows
+            const char* firstNl = static_cast<const char*>(memchr(begin, '\n', end - begin));
+            if (!carry.empty())
+            {
+                carry.append(begin, firstNl + 1);
+                onRows(carry.data(), carry.data() + carry.size());
+                consumed += carry.size();
+                carry.clear();
+                begin = firstNl + 1;
+            }
+
+            if (lastNl > begin)
+            {
+                onRows(begin, lastNl);
+                consumed += static_cast<size_t>(lastNl - begin);
+            }
+
+            carry.assign(lastNl, end);
+        }
+
+        // Old file fully drained, continue with its replacement
+        if (!reopenIfReplaced())
+            break;
+    }
+    return consumed;
+#else
+    (void)onRows;
+    return 0;
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Tracks a CSV that is still being appended to, like tail -F
+// Every readNew() picks up only the bytes written since the previous call
+// and passes on whole rows; a trailing row without its '\n' is held back
+// until the writer finishes it. A truncated file is read again from the
+// start, a replaced one (log rotation) is reopened once the old one is drained.
+class FileFollower {
+public:
+    // Receives [begin, end) of complete rows, end is right after a '\n'
+    using RowsFn = std::function<void(const char* begin, const char* end)>;
+
+    FileFollower() = default;
+    ~FileFollower();
+
+    FileFollower(const FileFollower&) = delete;
+    FileFollower& operator=(const FileFollower&) = delete;
+
+    // False if the file can't be opened or follow mode isn't supported here
+    bool open(const std::string& path, std::size_t blockBytes);
+
+    // Blocks up to timeoutMs until the file may have changed
+    // Uses inotify on Linux, otherwise checks the size every few milliseconds
+    void wait(int timeoutMs);
+
+    // Hands every newly completed row to onRows, returns their byte count
+    std::size_t readNew(const RowsFn& onRows);
+
+    // Bytes of complete rows consumed from the current file
+    std::uint64_t offset() const { return readPos - carry.size(); }
+
+private:
+    bool reopenIfReplaced();
+    std::uint64_t currentSize() const;
+
+    std::string path;
+    int fd = -1;
+    int notifyFd = -1;
+    std::uint64_t readPos = 0;   // bytes read from fd, carry included
+
+    std::vector<char> buffer;
+    std::string carry;           // partial last row
+};
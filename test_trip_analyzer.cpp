@@ -1,10 +1,37 @@
 #include "analyzer.h"
+#include "async_reader.h"
+#include "checkpoint.h"
+#include "compressed_input.h"
+#include "csv_scan.h"
+#include "decimal.h"
+#include "snapshot.h"
+#include "space_saving.h"
+#include "trip_id_filter.h"
+#include "timestamp.h"
+#include "zone_dictionary.h"
+#include "zone_stats.h"
 #include "catch_amalgamated.hpp"
 
+#include <filesystem>
 #include <fstream>
+#include <map>
 #include <string>
 #include <vector>
 #include <cstdio>   // std::remove
+#include <algorithm>
+#include <climits>
+#include <chrono>
+#include <tuple>
+#include <sstream>
+#include <thread>
+#include <unistd.h>  // pipe
+
+#ifdef TRIP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef TRIP_HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 // ------------------- helpers -------------------
 static void writeFile(const std::string& path, const std::vector<std::string>& lines) {
@@ -23,6 +50,36 @@ static bool hasSlot(const std::vector<SlotCount>& v, const std::string& zone, in
     return false;
 }
 
+static bool sameResults(const TripAnalyzer& a, const TripAnalyzer& b, int k) {
+    auto za = a.topZones(k), zb = b.topZones(k);
+    auto sa = a.topBusySlots(k), sb = b.topBusySlots(k);
+    if (za.size() != zb.size() || sa.size() != sb.size()) return false;
+    for (size_t i = 0; i < za.size(); ++i)
+        if (za[i].zone != zb[i].zone || za[i].count != zb[i].count) return false;
+    for (size_t i = 0; i < sa.size(); ++i)
+        if (sa[i].zone != sb[i].zone || sa[i].hour != sb[i].hour || sa[i].count != sb[i].count) return false;
+    return true;
+}
+
+// Re-ingests `path` with four workers over small chunks, then merges `single`
+// with a copy of the threaded result. Callers compare both against `single`.
+struct ThreadedAndMerged {
+    TripAnalyzer threaded;
+    TripAnalyzer merged;
+};
+
+static ThreadedAndMerged threadsAndMerges(const std::string& path, AnalyzerOptions opts,
+                                          const TripAnalyzer& single) {
+    opts.threads = 4;
+    opts.minChunkBytes = 4096;
+    ThreadedAndMerged r{ TripAnalyzer(opts), TripAnalyzer(opts) };
+    r.threaded.ingestFile(path);
+    REQUIRE(sameResults(single, r.threaded, 1000));
+    REQUIRE(r.merged.merge(single));
+    REQUIRE(r.merged.merge(TripAnalyzer(r.threaded)));
+    return r;
+}
+
 static const char* HDR = "TripID,PickupZoneID,DropoffZoneID,PickupDateTime,DistanceKm,FareAmount";
 
 // ------------------- A: ingestion robustness -------------------
@@ -281,3 +338,1809 @@ TEST_CASE("C3", "[C3]") {
 
     std::remove(path.c_str());
 }
+
+// ------------------- D: ingestion paths -------------------
+
+TEST_CASE("D1", "[D1]") {
+    const std::string path = "d1.csv";
+
+    // CRLF rows, dirty rows and a last row without a trailing newline
+    {
+        std::ofstream out(path, std::ios::binary);
+        REQUIRE(out.is_open());
+        out << HDR << "\r\n";
+        out << "1,ZONE_A,ZX,2024-01-01 09:15,1.2,10.0\r\n";
+        out << "2,,ZX,2024-01-01 09:15,1.2,10.0\r\n";
+        out << "\n";
+        out << "3, ZONE_B ,ZX,2024-01-01 23:59,1.2,10.0\n";
+        out << "4,ZONE_A,ZX,2024-01-01 10:00\n";
+        out << "5,ZONE_A,ZX,2024-01-01 09:00,1.0,2.0";
+    }
+
+    AnalyzerOptions streamOpts;
+    streamOpts.useMmap = false;
+
+    TripAnalyzer mapped;
+    TripAnalyzer streamed(streamOpts);
+    mapped.ingestFile(path);
+    streamed.ingestFile(path);
+
+    REQUIRE(sameResults(mapped, streamed, 10));
+    REQUIRE(hasZone(mapped.topZones(10), "ZONE_A", 2));
+    REQUIRE(hasSlot(mapped.topBusySlots(10), "ZONE_A", 9, 2));
+    REQUIRE(hasSlot(mapped.topBusySlots(10), "ZONE_B", 23, 1));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("D2", "[D2]") {
+    // Empty file and non-mappable inputs fall back without crashing
+    const std::string path = "d2.csv";
+    writeFile(path, {});
+
+    TripAnalyzer ta;
+    ta.ingestFile(path);
+    ta.ingestFile("/proc/self/status");
+    ta.ingestFile(".");
+
+    REQUIRE(ta.topZones(10).empty());
+    REQUIRE(ta.topBusySlots(10).empty());
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("D3", "[D3]") {
+    const std::string path = "d3.csv";
+
+    // Dirty rows sprinkled everywhere so some land on chunk edges
+    std::ofstream out(path, std::ios::binary);
+    REQUIRE(out.is_open());
+    out << HDR << "\n";
+    for (int i = 0; i < 5000; ++i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "2024-01-01 %02d:%02d", i % 24, i % 60);
+        out << i << ",ZONE_" << (i % 37) << ",ZX," << buf << ",1.0,5.0\n";
+        if (i % 7 == 0) out << i << ",,ZX," << buf << ",1.0,5.0\n";
+        if (i % 11 == 0) out << "\n";
+        if (i % 13 == 0) out << i << ",ZONE_X,ZX,BAD,1.0,5.0\n";
+    }
+    out << "9999,ZONE_LAST,ZX,2024-01-01 05:00,1.0,5.0";
+    out.close();
+
+    TripAnalyzer single;
+    single.ingestFile(path);
+
+    for (unsigned threads : {2u, 3u, 8u}) {
+        AnalyzerOptions opts;
+        opts.threads = threads;
+        opts.minChunkBytes = 1;
+
+        TripAnalyzer parallel(opts);
+        parallel.ingestFile(path);
+        REQUIRE(sameResults(single, parallel, 1000));
+    }
+
+    REQUIRE(hasZone(single.topZones(100), "ZONE_LAST", 1));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("D4", "[D4]") {
+    // Rows crossing 64-byte blocks, extra commas, empty rows, no final newline
+    std::string text = std::string(HDR) + "\n\n";
+    for (int i = 0; i < 200; ++i)
+        text += std::to_string(i) + "," + std::string(i % 70, 'Z') + ",ZX,2024-01-01 10:00,1,2,extra,,\n";
+    text += "last,row";
+
+    struct Row { size_t length; std::vector<size_t> commas; };
+    auto collect = [&](BlockScanFn scan) {
+        std::vector<Row> rows;
+        scanRows(text.data(), text.data() + text.size(), scan,
+                 [&](const char*, size_t length, const size_t* commas, int count) {
+            rows.push_back({ length, std::vector<size_t>(commas, commas + count) });
+        });
+        return rows;
+    };
+
+    // Reference split: getline semantics plus find for the first five commas
+    std::vector<Row> expected;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t nl = text.find('\n', start);
+        size_t end = nl == std::string::npos ? text.size() : nl;
+        Row r{ end - start, {} };
+        for (size_t c = text.find(',', start); c < end && r.commas.size() < 5; c = text.find(',', c + 1))
+            r.commas.push_back(c - start);
+        expected.push_back(r);
+        start = end + 1;
+    }
+
+    // Bit scans behind the row walk
+    for (int b = 0; b < 64; ++b) {
+        REQUIRE(ctz64((std::uint64_t(1) << b) | (std::uint64_t(1) << 63)) == b);
+        if (b < 32) REQUIRE(ctz32((1u << b) | 0x80000000u) == b);
+    }
+    REQUIRE(popcount32(0) == 0);
+    REQUIRE(popcount32(0xF00F0001u) == 9);
+
+    size_t count = 0;
+    const BlockScanKernel* kernels = blockScanKernels(count);
+    for (size_t k = 0; k < count; ++k) {
+        if (!kernels[k].supported) continue;
+
+        auto rows = collect(kernels[k].scan);
+        REQUIRE(rows.size() == expected.size());
+        bool same = true;
+        for (size_t i = 0; i < rows.size(); ++i)
+            same = same && rows[i].length == expected[i].length && rows[i].commas == expected[i].commas;
+        REQUIRE(same);
+    }
+}
+
+TEST_CASE("D5", "[D5]") {
+    // Stream and fd ingestion with blocks small enough to split rows
+    std::string text = std::string(HDR) + "\r\n";
+    for (int i = 0; i < 3000; ++i) {
+        text += std::to_string(i) + ",ZONE_" + std::to_string(i % 17) + ",ZX,2024-01-01 " +
+                std::to_string(i % 24) + ":30,1,1\n";
+        if (i % 9 == 0) text += ",ZONE_BAD,ZX,2024-01-01 10:00,1,1\n\n";
+    }
+    text += "tail,ZONE_TAIL,ZX,2024-01-01 04:00,1,1";
+
+    const std::string path = "d5.csv";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+    TripAnalyzer reference;
+    reference.ingestFile(path);
+    REQUIRE(hasZone(reference.topZones(100), "ZONE_TAIL", 1));
+
+    for (size_t block : {size_t(64), size_t(100), size_t(1) << 20}) {
+        AnalyzerOptions opts;
+        opts.readBlockBytes = block;
+
+        std::istringstream in(text);
+        TripAnalyzer streamed(opts);
+        streamed.ingestStream(in);
+        REQUIRE(sameResults(reference, streamed, 1000));
+
+        // A pipe delivers short reads, fed by a writer thread
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        std::thread writer([&] {
+            for (size_t off = 0; off < text.size(); off += 777) {
+                size_t n = std::min<size_t>(777, text.size() - off);
+                if (write(fds[1], text.data() + off, n) != static_cast<ssize_t>(n)) break;
+            }
+            close(fds[1]);
+        });
+        TripAnalyzer piped(opts);
+        piped.ingestFd(fds[0]);
+        writer.join();
+        close(fds[0]);
+        REQUIRE(sameResults(reference, piped, 1000));
+
+        // mmap turned off routes files through the fd reader
+        opts.useMmap = false;
+        TripAnalyzer unmapped(opts);
+        unmapped.ingestFile(path);
+        REQUIRE(sameResults(reference, unmapped, 1000));
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("D6", "[D6]") {
+    // Compressed inputs decode to the same aggregates as the plain file
+    std::string text = std::string(HDR) + "\n";
+    for (int i = 0; i < 40000; ++i)
+        text += std::to_string(i) + ",ZONE_" + std::to_string(i % 101) + ",ZX,2024-01-01 " +
+                std::to_string(i % 24) + ":00,1,1\n";
+    text += "x,ZONE_TAIL,ZX,2024-01-01 01:00,1,1";
+
+    const std::string plain = "d6.csv";
+    {
+        std::ofstream out(plain, std::ios::binary);
+        out << text;
+    }
+    TripAnalyzer reference;
+    reference.ingestFile(plain);
+
+    auto check = [&](const std::string& path, bool expectRows) {
+        for (unsigned threads : {1u, 4u}) {
+            AnalyzerOptions opts;
+            opts.threads = threads;
+            opts.readBlockBytes = 4096;
+            TripAnalyzer ta(opts);
+            ta.ingestFile(path);
+            if (expectRows) REQUIRE(sameResults(reference, ta, 1000));
+            else REQUIRE(ta.topZones(10).empty());
+            REQUIRE(ta.decodeErrors() == (expectRows ? 0 : 1));
+        }
+    };
+
+    // Without the codec compiled in the file is skipped, never misparsed
+    const std::string gz = "d6.csv.gz";
+    {
+        std::ofstream out(gz, std::ios::binary);
+        const unsigned char hdr[] = { 0x1F, 0x8B, 0x08, 0, 0, 0, 0, 0, 0, 0xFF };
+        out.write(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+    }
+    REQUIRE(detectCodec("\x1F\x8B", 2) == InputCodec::Gzip);
+    check(gz, false);
+
+#ifdef TRIP_HAVE_ZLIB
+    // Two concatenated gzip members, split mid-row
+    {
+        size_t half = text.size() / 2 + 3;
+        gzFile f = gzopen(gz.c_str(), "wb");
+        gzwrite(f, text.data(), static_cast<unsigned>(half));
+        gzclose(f);
+        f = gzopen(gz.c_str(), "ab");
+        gzwrite(f, text.data() + half, static_cast<unsigned>(text.size() - half));
+        gzclose(f);
+    }
+    check(gz, true);
+
+    // Cut short: the rows before the cut count, the file is reported
+    {
+        std::ifstream in(gz, std::ios::binary);
+        std::string whole((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream(gz, std::ios::binary) << whole.substr(0, whole.size() / 2);
+    }
+    TripAnalyzer cut;
+    cut.ingestFile(gz);
+    REQUIRE(cut.decodeErrors() == 1);
+    REQUIRE_FALSE(cut.topZones(10).empty());
+
+    AnalyzerOptions many;
+    many.threads = 4;
+    TripAnalyzer cutFiles(many);
+    cutFiles.ingestFiles({ gz, plain });
+    REQUIRE(cutFiles.decodeErrors() == 1);
+#endif
+
+#ifdef TRIP_HAVE_ZSTD
+    // Independent frames, the pzstd layout that decodes in parallel
+    const std::string zst = "d6.csv.zst";
+    {
+        std::ofstream out(zst, std::ios::binary);
+        for (size_t off = 0; off < text.size(); off += 50000) {
+            size_t n = std::min<size_t>(50000, text.size() - off);
+            std::string frame(ZSTD_compressBound(n), '\0');
+            size_t got = ZSTD_compress(&frame[0], frame.size(), text.data() + off, n, 3);
+            out.write(frame.data(), static_cast<std::streamsize>(got));
+        }
+    }
+    check(zst, true);
+    std::remove(zst.c_str());
+#endif
+
+    std::remove(plain.c_str());
+    std::remove(gz.c_str());
+}
+
+TEST_CASE("D7", "[D7]") {
+    // Async block reads match the mapped path, on both backends
+    std::string text = std::string(HDR) + "\n";
+    for (int i = 0; i < 30000; ++i)
+        text += std::to_string(i) + ",ZONE_" + std::to_string(i % 97) + ",ZX,2024-01-01 " +
+                std::to_string(i % 24) + ":00,1,1\n";
+    // One row spanning several blocks
+    text += std::string(10000, 'L') + ",ZONE_LONG,ZX,2024-01-01 05:00,1,1\n";
+    text += "x,ZONE_TAIL,ZX,2024-01-01 01:00,1,1";
+
+    const std::string path = "d7.csv";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+    TripAnalyzer reference;
+    reference.ingestFile(path);
+    REQUIRE(hasZone(reference.topZones(200), "ZONE_LONG", 1));
+
+    for (bool uring : {true, false}) {
+        for (unsigned depth : {2u, 5u}) {
+            AnalyzerOptions opts;
+            opts.asyncIo = true;
+            opts.useIoUring = uring;
+            opts.ioQueueDepth = depth;
+            opts.readBlockBytes = 4096;
+            TripAnalyzer ta(opts);
+            ta.ingestFile(path);
+            REQUIRE(sameResults(reference, ta, 1000));
+
+            IoStats io = ta.ioStats();
+            REQUIRE(io.bytes == text.size());
+            REQUIRE(io.blocks == (text.size() + 4095) / 4096);
+            if (!uring) REQUIRE(std::string(io.backend) == "pread");
+        }
+
+        // Workers split every block and keep their tables across blocks
+        AnalyzerOptions opts;
+        opts.asyncIo = true;
+        opts.useIoUring = uring;
+        opts.readBlockBytes = 65536;
+        opts.minChunkBytes = 4096;
+        opts.threads = 4;
+        TripAnalyzer ta(opts);
+        ta.ingestFile(path);
+        REQUIRE(sameResults(reference, ta, 1000));
+        REQUIRE(ta.ioStats().bytes == text.size());
+    }
+
+    // The reader itself hands the file back in order
+    for (auto backend : {AsyncFileReader::Backend::IoUring, AsyncFileReader::Backend::Pread}) {
+        AsyncFileReader reader;
+        if (!reader.open(path, 4096, 3, backend)) {
+            REQUIRE(backend == AsyncFileReader::Backend::IoUring);  // kernel without io_uring
+            continue;
+        }
+        std::string back;
+        const char* data;
+        size_t length;
+        while (reader.next(data, length))
+            back.append(data, length);
+        REQUIRE(reader.ok());
+        REQUIRE(back == text);
+    }
+
+    // Directories have no size to split into blocks
+    AsyncFileReader dir;
+    REQUIRE_FALSE(dir.open(".", 4096, 2));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("D8", "[D8]") {
+    // Many files at once equal ingesting them one by one
+    auto makeRows = [](int rows, int zones, const std::string& tag) {
+        std::string text = std::string(HDR) + "\n";
+        for (int i = 0; i < rows; ++i)
+            text += tag + std::to_string(i) + ",ZONE_" + std::to_string(i % zones) +
+                    ",ZX,2024-01-01 " + std::to_string(i % 24) + ":00,1,1\n";
+        return text;
+    };
+
+    std::filesystem::create_directory("d8_dir");
+    std::vector<std::string> paths = { "d8_dir/big.csv", "d8_dir/a.csv", "d8_dir/b.csv" };
+    {
+        std::ofstream(paths[0], std::ios::binary) << makeRows(50000, 211, "g");
+        std::ofstream(paths[1], std::ios::binary) << makeRows(300, 7, "a");
+        // No trailing newline on the last row
+        std::ofstream(paths[2], std::ios::binary) << makeRows(200, 13, "b") << "z,ZONE_END,ZX,2024-01-01 03:00,1,1";
+        std::ofstream("d8_dir/notes.txt") << "not,a,trip\n";
+    }
+
+    TripAnalyzer sequential;
+    for (const auto& p : paths) sequential.ingestFile(p);
+
+    for (unsigned threads : {1u, 4u}) {
+        AnalyzerOptions opts;
+        opts.threads = threads;
+        opts.minChunkBytes = 4096;
+
+        TripAnalyzer ta(opts);
+        std::vector<std::string> withMissing = paths;
+        withMissing.push_back("d8_dir/missing.csv");
+        ta.ingestFiles(withMissing);
+        REQUIRE(sameResults(sequential, ta, 1000));
+
+        TripAnalyzer dir(opts);
+        REQUIRE(dir.ingestDirectory("d8_dir", "*.csv") == 3);
+        REQUIRE(sameResults(sequential, dir, 1000));
+    }
+
+    TripAnalyzer some;
+    REQUIRE(some.ingestDirectory("d8_dir", "?.csv") == 2);
+    REQUIRE(hasZone(some.topZones(50), "ZONE_END", 1));
+    REQUIRE(some.ingestDirectory("no_such_dir") == 0);
+
+    std::filesystem::remove_all("d8_dir");
+}
+
+TEST_CASE("D9", "[D9]") {
+    // Follow mode only ingests what was appended since the last poll
+    const std::string path = "d9.csv";
+    auto append = [&](const std::string& text) {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << text;
+    };
+    std::remove(path.c_str());
+
+    const std::string head = std::string(HDR) + "\n" +
+                             "1,ZONE_A,ZX,2024-01-01 08:00,1,1\n" +
+                             "2,ZONE_A,ZX,2024-01-01 09:00,1,1\n";
+    append(head + "3,ZONE_B,ZX,2024-01-");
+
+    TripAnalyzer ta;
+    REQUIRE_FALSE(ta.follow("missing_d9.csv"));
+    REQUIRE(ta.pollFollow() == 0);
+
+    REQUIRE(ta.follow(path));
+    REQUIRE(ta.followOffset() == head.size());
+    REQUIRE(hasZone(ta.topZones(), "ZONE_A", 2));
+    REQUIRE(ta.topZones().size() == 1);  // partial ZONE_B row held back
+
+    REQUIRE(ta.pollFollow() == 0);
+
+    // The held-back row completes, plus a new one
+    const std::string more = "01 10:00,1,1\n4,ZONE_B,ZX,2024-01-01 10:00,1,1\n";
+    append(more);
+    REQUIRE(ta.pollFollow() > 0);
+    REQUIRE(hasZone(ta.topZones(), "ZONE_B", 2));
+    REQUIRE(hasSlot(ta.topBusySlots(), "ZONE_B", 10, 2));
+
+    // A writer on another thread wakes a blocking poll
+    std::thread writer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        append("5,ZONE_C,ZX,2024-01-01 11:00,1,1\n");
+    });
+    size_t got = 0;
+    for (int i = 0; i < 20 && got == 0; ++i)
+        got = ta.pollFollow(1000);
+    writer.join();
+    REQUIRE(got > 0);
+    REQUIRE(hasZone(ta.topZones(), "ZONE_C", 1));
+
+    // Replaced by a new file: read from its start
+    {
+        std::ofstream out("d9_next.csv", std::ios::binary);
+        out << "6,ZONE_D,ZX,2024-01-01 12:00,1,1\n";
+    }
+    REQUIRE(std::rename("d9_next.csv", path.c_str()) == 0);
+    REQUIRE(ta.pollFollow() > 0);
+    REQUIRE(hasZone(ta.topZones(), "ZONE_D", 1));
+    REQUIRE(hasZone(ta.topZones(), "ZONE_A", 2));
+
+    ta.stopFollowing();
+    append("7,ZONE_D,ZX,2024-01-01 12:00,1,1\n");
+    REQUIRE(ta.pollFollow() == 0);
+    REQUIRE(hasZone(ta.topZones(), "ZONE_D", 1));
+
+    std::remove(path.c_str());
+}
+
+// ------------------- E: aggregate storage -------------------
+
+TEST_CASE("E1", "[E1]") {
+    ZoneDictionary dict;
+
+    std::string key = "ZONE_A";
+    REQUIRE(dict.intern(key) == 0);
+    REQUIRE(dict.intern("ZONE_B") == 1);
+
+    // Stored names must not alias the caller's buffer
+    key = "ZONE_C";
+    REQUIRE(dict.intern("ZONE_A") == 0);
+    REQUIRE(dict.intern(key) == 2);
+
+    REQUIRE(dict.size() == 3);
+    REQUIRE(dict.name(0) == "ZONE_A");
+    REQUIRE(dict.find("ZONE_B") == 1);
+    REQUIRE(dict.find("zone_b") == ZoneDictionary::npos);
+}
+
+TEST_CASE("E2", "[E2]") {
+    ZoneStatsTable a, b;
+    a.add("ZONE_A", 0);
+    a.add("ZONE_A", 23);
+    b.add("ZONE_B", 5);
+    b.add("ZONE_A", 23);
+
+    a.merge(b);
+
+    REQUIRE(a.size() == 2);
+    uint32_t za = a.zones().find("ZONE_A");
+    uint32_t zb = a.zones().find("ZONE_B");
+    REQUIRE(a.stats(za).total == 3);
+    REQUIRE(a.stats(za).hours[0] == 1);
+    REQUIRE(a.stats(za).hours[23] == 2);
+    REQUIRE(a.stats(zb).total == 1);
+    REQUIRE(a.stats(zb).hours[5] == 1);
+}
+
+TEST_CASE("E3", "[E3]") {
+    // Growth across many rehashes, inline and out-of-line keys
+    ZoneDictionary dict;
+    const std::string longPrefix(40, 'L');
+
+    bool dense = true;
+    for (int i = 0; i < 100000; ++i) {
+        std::string key = (i % 10 == 0 ? longPrefix : "ZONE") + std::to_string(i);
+        dense = dense && dict.intern(key) == static_cast<uint32_t>(i);
+    }
+
+    REQUIRE(dense);
+    REQUIRE(dict.size() == 100000);
+    REQUIRE(dict.find("ZONE99999") == 99999);
+    REQUIRE(dict.find(longPrefix + "99990") == 99990);
+    REQUIRE(dict.find(longPrefix + "99991") == ZoneDictionary::npos);
+    REQUIRE(dict.find("ZONE") == ZoneDictionary::npos);
+    REQUIRE(dict.name(12345) == "ZONE12345");
+
+    // Same-length keys that differ only in the last byte
+    REQUIRE(dict.intern("ZONE1234") == 1234);
+    REQUIRE(dict.intern("ZONE1235") == 1235);
+}
+
+TEST_CASE("E4", "[E4]") {
+    // Heap selection must match a full sort, heavy ties on purpose
+    const std::string path = "e4.csv";
+
+    std::ofstream out(path);
+    REQUIRE(out.is_open());
+    out << HDR << "\n";
+    for (int i = 0; i < 20000; ++i)
+        out << i << ",Z" << (i * 7919) % 300 << ",ZX,2024-01-01 " << (i * 31) % 24 << ":00,1,1\n";
+    out.close();
+
+    TripAnalyzer ta;
+    ta.ingestFile(path);
+
+    auto allZ = ta.topZones(1000);
+    auto allS = ta.topBusySlots(100000);
+    REQUIRE(allZ.size() == 300);
+
+    auto zoneOrder = [](const ZoneCount& a, const ZoneCount& b) {
+        return std::make_tuple(-a.count, a.zone) < std::make_tuple(-b.count, b.zone);
+    };
+    auto slotOrder = [](const SlotCount& a, const SlotCount& b) {
+        return std::make_tuple(-a.count, a.zone, a.hour) < std::make_tuple(-b.count, b.zone, b.hour);
+    };
+    REQUIRE(std::is_sorted(allZ.begin(), allZ.end(), zoneOrder));
+    REQUIRE(std::is_sorted(allS.begin(), allS.end(), slotOrder));
+
+    // Every prefix query agrees with the full ranking
+    for (int k : {0, 1, 7, 50, 299}) {
+        auto z = ta.topZones(k);
+        auto s = ta.topBusySlots(k);
+        REQUIRE(z.size() == static_cast<size_t>(k));
+        REQUIRE(s.size() == static_cast<size_t>(k));
+        for (int i = 0; i < k; ++i) {
+            REQUIRE(z[i].zone == allZ[i].zone);
+            REQUIRE(s[i].zone == allS[i].zone);
+            REQUIRE(s[i].hour == allS[i].hour);
+        }
+    }
+
+    REQUIRE(ta.topZones(-1).empty());
+    REQUIRE(ta.topBusySlots(-1).empty());
+
+    // k far beyond the table is just "everything", nothing is sized by k
+    AnalyzerOptions all;
+    all.trackDays = all.trackMinutes = all.trackAmounts = all.trackRoutes = true;
+    all.trackWeekdays = all.trackQuarterHours = all.trackFiveMinutes = true;
+    TripAnalyzer wide(all);
+    wide.ingestFile(path);
+    REQUIRE(wide.topZones(INT_MAX).size() == 300);
+    REQUIRE(wide.topBusySlots(INT_MAX).size() == allS.size());
+    REQUIRE(wide.busiestDays(INT_MAX).size() == 1);
+    REQUIRE(wide.topZoneDays(INT_MAX).size() == 300);
+    REQUIRE(wide.busiestMinutes(INT_MAX).size() == 24);
+    REQUIRE(wide.topZonesByRevenue(INT_MAX).size() == 300);
+    REQUIRE(wide.topZonesByDistance(INT_MAX).size() == 300);
+    REQUIRE(wide.topWeeklySlots(INT_MAX).size() == allS.size());
+    REQUIRE(wide.topQuarterHourSlots(INT_MAX).size() == allS.size());
+    REQUIRE(wide.topFiveMinuteSlots(INT_MAX).size() == allS.size());
+    REQUIRE(wide.topRoutes(INT_MAX).size() == 300);
+    REQUIRE(wide.topDestinationsFrom("Z0", INT_MAX).size() == 1);
+
+    AnalyzerOptions approx;
+    approx.heavyHitterCapacity = 64;
+    TripAnalyzer small(approx);
+    small.ingestFile(path);
+    REQUIRE(small.topZones(INT_MAX).size() == 64);
+    REQUIRE(small.topBusySlots(INT_MAX).size() == 64);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("E5", "[E5]") {
+    const std::string path = "e5.csv";
+    writeFile(path, {
+        HDR,
+        "1,ZONE_A,ZX,2024-01-01 10:00,1,1",
+        "2,ZONE_A,ZX,2024-01-01 11:00,1,1",
+        "3,ZONE_B,ZX,2024-01-01 10:00,1,1"
+    });
+
+    TripAnalyzer ta;
+    ta.ingestFile(path);
+
+    auto first = ta.topZones(10);
+    ta.topZones(10);
+    ta.topZones(1);          // prefix of the cached ranking
+    ta.topBusySlots(2);
+    ta.topBusySlots(2);
+    ta.topBusySlots(5);      // deeper than cached -> recompute
+
+    CacheStats st = ta.cacheStats();
+    REQUIRE(st.zoneMisses == 1);
+    REQUIRE(st.zoneHits == 2);
+    REQUIRE(st.slotMisses == 2);
+    REQUIRE(st.slotHits == 1);
+
+    // Ingesting again invalidates, the cached answer must not be stale
+    ta.ingestFile(path);
+    auto second = ta.topZones(10);
+    REQUIRE(ta.cacheStats().zoneMisses == 2);
+    REQUIRE(first[0].count == 2);
+    REQUIRE(second[0].count == 4);
+    REQUIRE(hasSlot(ta.topBusySlots(10), "ZONE_A", 10, 2));
+
+    AnalyzerOptions opts;
+    opts.cacheResults = false;
+    TripAnalyzer uncached(opts);
+    uncached.ingestFile(path);
+    uncached.ingestFile(path);
+    REQUIRE(sameResults(ta, uncached, 10));
+    REQUIRE(uncached.cacheStats().zoneMisses == 0);
+
+    std::remove(path.c_str());
+}
+
+// ------------------- F: persistence and merging -------------------
+
+TEST_CASE("F1", "[F1]") {
+    const std::string path = "f1.csv";
+    const std::string snap = "f1.snap";
+
+    std::ofstream out(path);
+    REQUIRE(out.is_open());
+    out << HDR << "\n";
+    for (int i = 0; i < 5000; ++i)
+        out << i << ",ZONE_" << (i % 123) << ",ZX,2024-01-01 " << (i % 24) << ":15,1,1\n";
+    out << "5000," << std::string(60, 'L') << ",ZX,2024-01-01 03:00,1,1\n";
+    out.close();
+
+    TripAnalyzer original;
+    original.ingestFile(path);
+    REQUIRE(original.saveSnapshot(snap));
+
+    TripAnalyzer restored;
+    REQUIRE(restored.loadSnapshot(snap));
+    REQUIRE(sameResults(original, restored, 10000));
+
+    // A loaded snapshot keeps aggregating like the original would
+    original.ingestFile(path);
+    restored.ingestFile(path);
+    REQUIRE(sameResults(original, restored, 10000));
+
+    // Flip one payload byte: the checksum rejects it, state is kept
+    {
+        std::fstream f(snap, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(100);
+        f.put('\x7f');
+    }
+    TripAnalyzer corrupt;
+    corrupt.ingestFile(path);
+    REQUIRE_FALSE(corrupt.loadSnapshot(snap));
+    REQUIRE_FALSE(corrupt.loadSnapshot("missing_snapshot_123.snap"));
+    REQUIRE_FALSE(corrupt.loadSnapshot(path));
+    REQUIRE(hasZone(corrupt.topZones(200), "ZONE_0", 41));
+
+    std::remove(path.c_str());
+    std::remove(snap.c_str());
+}
+
+TEST_CASE("F2", "[F2]") {
+    // Three shards aggregated separately must equal one single-node run
+    const std::vector<std::string> shards = { "f2_0.csv", "f2_1.csv", "f2_2.csv" };
+    const std::string whole = "f2_all.csv";
+
+    std::ofstream all(whole);
+    std::vector<std::ofstream> parts;
+    for (const auto& p : shards) parts.emplace_back(p);
+    all << HDR << "\n";
+    for (auto& p : parts) p << HDR << "\n";
+
+    for (int i = 0; i < 9000; ++i) {
+        std::string row = std::to_string(i) + ",ZONE_" + std::to_string((i * 13) % 211) +
+                          ",ZX,2024-01-01 " + std::to_string((i * 5) % 24) + ":00,1,1";
+        all << row << "\n";
+        parts[(i / 100) % 3] << row << "\n";
+    }
+    all.close();
+    for (auto& p : parts) p.close();
+
+    TripAnalyzer single;
+    single.ingestFile(whole);
+
+    std::vector<TripAnalyzer> workers(3);
+    for (size_t i = 0; i < shards.size(); ++i)
+        workers[i].ingestFile(shards[i]);
+
+    // Copy-merge
+    TripAnalyzer copyMerged;
+    for (const auto& w : workers) copyMerged.merge(w);
+    REQUIRE(sameResults(single, copyMerged, 10000));
+
+    // Serialized partials, as exchanged between machines
+    TripAnalyzer wireMerged;
+    for (const auto& w : workers) REQUIRE(wireMerged.mergeAggregates(w.exportAggregates()));
+    REQUIRE(sameResults(single, wireMerged, 10000));
+    REQUIRE_FALSE(wireMerged.mergeAggregates("not an aggregate"));
+    REQUIRE(sameResults(single, wireMerged, 10000));
+
+    // Move-merge leaves the sources empty
+    TripAnalyzer moveMerged;
+    for (auto& w : workers) moveMerged.merge(std::move(w));
+    REQUIRE(sameResults(single, moveMerged, 10000));
+    REQUIRE(workers[0].topZones(10).empty());
+
+    std::remove(whole.c_str());
+    for (const auto& p : shards) std::remove(p.c_str());
+}
+
+TEST_CASE("F3", "[F3]") {
+    // A run resumed from a checkpoint ends with the same totals
+    std::string text = std::string(HDR) + "\n";
+    for (int i = 0; i < 20000; ++i)
+        text += std::to_string(i) + ",ZONE_" + std::to_string(i % 53) + ",ZX,2024-01-01 " +
+                std::to_string(i % 24) + ":00,1,1\n";
+
+    const std::string path = "f3.csv";
+    const std::string ckpt = "f3.ckpt";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << text;
+    }
+    TripAnalyzer reference;
+    reference.ingestFile(path);
+
+    AnalyzerOptions opts;
+    opts.checkpointPath = ckpt;
+    opts.checkpointEveryBytes = 4096;
+    opts.threads = 2;
+    opts.minChunkBytes = 1024;
+
+    // Checkpointing along the way changes nothing, and cleans up after itself
+    {
+        TripAnalyzer ta(opts);
+        ta.ingestFile(path);
+        REQUIRE(sameResults(reference, ta, 1000));
+        REQUIRE_FALSE(std::ifstream(ckpt).good());
+        REQUIRE_FALSE(ta.checkpointSkipped());
+        REQUIRE_FALSE(reference.checkpointSkipped());
+    }
+
+    // A crashed run left a checkpoint after the first half of the rows
+    size_t half = text.find('\n', text.size() / 2) + 1;
+    ZoneStatsTable partial;
+    {
+        std::ofstream(path + ".head", std::ios::binary) << text.substr(0, half);
+        TripAnalyzer head;
+        head.ingestFile(path + ".head");
+        std::string bytes = head.exportAggregates();
+        REQUIRE(decodeSnapshot(bytes.data(), bytes.size(), partial));
+        std::remove((path + ".head").c_str());
+    }
+    // Marks aggregates that can only have come from the checkpoint
+    partial.add("ZONE_MARK", 3);
+
+    CheckpointSource source;
+    REQUIRE(checkpointSource(path, source));
+    REQUIRE(writeCheckpointFile(ckpt, source, half, partial));
+    {
+        TripAnalyzer resumed(opts);
+        resumed.ingestFile(path);
+        REQUIRE(hasZone(resumed.topZones(100), "ZONE_MARK", 1));
+        REQUIRE_FALSE(resumed.checkpointSkipped());
+        TripAnalyzer expected = reference;
+        expected.mergeAggregates([] {
+            ZoneStatsTable mark;
+            mark.add("ZONE_MARK", 3);
+            return encodeSnapshot(mark);
+        }());
+        REQUIRE(sameResults(expected, resumed, 1000));
+        REQUIRE_FALSE(std::ifstream(ckpt).good());
+    }
+
+    // A checkpoint of a different input is ignored
+    CheckpointSource other = source;
+    other.size += 1;
+    REQUIRE(writeCheckpointFile(ckpt, other, half, partial));
+    {
+        TripAnalyzer ta(opts);
+        ta.ingestFile(path);
+        REQUIRE(sameResults(reference, ta, 1000));
+    }
+
+    // So is a damaged one
+    std::ofstream(ckpt, std::ios::binary) << "TRIPCKPT garbage";
+    {
+        TripAnalyzer ta(opts);
+        ta.ingestFile(path);
+        REQUIRE(sameResults(reference, ta, 1000));
+    }
+
+    // Day counts aren't in the image, so with trackDays the file is read
+    // from the start and the checkpoint is left alone
+    REQUIRE(writeCheckpointFile(ckpt, source, half, partial));
+    {
+        AnalyzerOptions days = opts;
+        days.trackDays = true;
+        TripAnalyzer ta(days);
+        ta.ingestFile(path);
+        REQUIRE(sameResults(reference, ta, 1000));
+        REQUIRE_FALSE(hasZone(ta.topZones(100), "ZONE_MARK", 1));
+        auto perDay = ta.tripsPerDay();
+        REQUIRE(perDay.size() == 1);
+        REQUIRE(perDay[0].count == 20000);
+        REQUIRE(std::ifstream(ckpt).good());
+        REQUIRE(ta.checkpointSkipped());
+    }
+
+    // asyncIo reads blocks without checkpoints, and says so
+    {
+        AnalyzerOptions async = opts;
+        async.asyncIo = true;
+        TripAnalyzer ta(async);
+        ta.ingestFile(path);
+        REQUIRE(sameResults(reference, ta, 1000));
+        REQUIRE_FALSE(hasZone(ta.topZones(100), "ZONE_MARK", 1));
+        REQUIRE(std::ifstream(ckpt).good());
+        REQUIRE(ta.checkpointSkipped());
+    }
+
+    // ingestFiles doesn't checkpoint, with mapped or async reads
+    for (bool async : { false, true }) {
+        AnalyzerOptions many = opts;
+        many.asyncIo = async;
+        many.threads = 4;
+        TripAnalyzer ta(many);
+        ta.ingestFiles({ path });
+        REQUIRE(sameResults(reference, ta, 1000));
+        REQUIRE(std::ifstream(ckpt).good());
+        REQUIRE(ta.checkpointSkipped());
+    }
+
+    // Nor do the analyzers it reads whole files with, so two files read
+    // at once never write or resume each other's checkpoint
+    const std::string second = "f3b.csv";
+    {
+        std::string renamed = text;
+        for (size_t at = renamed.find("ZONE_"); at != std::string::npos; at = renamed.find("ZONE_", at))
+            renamed.replace(at, 5, "ZB_");
+        std::ofstream(second, std::ios::binary) << renamed;
+    }
+    TripAnalyzer both;
+    both.ingestFile(path);
+    both.ingestFile(second);
+    for (int mode = 0; mode < 2; ++mode) {
+        REQUIRE(writeCheckpointFile(ckpt, source, half, partial));
+        AnalyzerOptions many = opts;
+        many.threads = 2;
+        many.useMmap = mode == 0;
+        many.asyncIo = mode == 1;
+        TripAnalyzer ta(many);
+        ta.ingestFiles({ path, second });
+        REQUIRE(sameResults(both, ta, 1000));
+        REQUIRE_FALSE(hasZone(ta.topZones(200), "ZONE_MARK", 1));
+        size_t offset = 0;
+        ZoneStatsTable saved;
+        REQUIRE(readCheckpointFile(ckpt, source, offset, saved));
+        REQUIRE(offset == half);
+    }
+
+    std::remove(second.c_str());
+    std::remove(ckpt.c_str());
+    std::remove(path.c_str());
+}
+
+// ------------------- G: field parsing -------------------
+
+TEST_CASE("G1", "[G1]") {
+    Timestamp t{};
+    REQUIRE(parseTimestamp("2024-02-29 23:59", t));
+    REQUIRE(t.year == 2024);
+    REQUIRE(t.month == 2);
+    REQUIRE(t.day == 29);
+    REQUIRE(t.hour == 23);
+    REQUIRE(t.minute == 59);
+
+    // Fixed layout and the slow path agree on the hour
+    REQUIRE(parseHour("2024-01-01 00:00") == 0);
+    REQUIRE(parseHour("2024-01-01 7:05") == 7);
+    REQUIRE(parseHour("  2024-1-9   07:05  ") == 7);
+    REQUIRE(parseHour("2024-01-01T18:30") == 18);
+    REQUIRE(parseHour("2024-01-01 18:30:59") == 18);
+    REQUIRE(parseHour("2000-02-29 12:00") == 12);
+
+    // Garbage the old colon search used to accept
+    for (const char* bad : { "x5:00", "10:00", "2024-01-01 x5:00", "2024-01-01 25:00",
+                             "2024-01-01 24:00", "2024-01-01 10:60", "2024-13-01 10:00",
+                             "2024-00-10 10:00", "2024-04-31 10:00", "2023-02-29 10:00",
+                             "1900-02-29 10:00", "2024-01-01 10:0", "2024-01-01 100:00",
+                             "2024-01-01 10:00:60", "2024-01-01 10:00 PM", "2024/01/01 10:00",
+                             "20240101 10:00", "2024-01-0110:00", "2O24-01-01 10:00",
+                             "2024-01-01 1:5", "", "Not-A-Date" })
+        REQUIRE(parseHour(bad) == -1);
+
+    // Every fixed-layout string with one character replaced is either
+    // still a valid timestamp or rejected, never misread. Only the
+    // irregular spacing the slow path allows may differ
+    const std::string good = "2024-06-15 13:45";
+    bool consistent = true;
+    for (size_t i = 0; i < good.size(); ++i) {
+        for (int c = 0; c < 256; ++c) {
+            std::string s = good;
+            s[i] = static_cast<char>(c);
+            Timestamp fast{}, slow{};
+            bool fastOk = parseTimestampFixed(s.data(), fast);
+            bool slowOk = parseTimestampSlow(std::string(" ") + s, slow);
+            bool spacing = c == ' ' || c == '\t' || c == 'T';
+            if (fastOk != slowOk && !(slowOk && spacing))
+                consistent = false;
+            if (fastOk && (fast.hour != slow.hour || fast.day != slow.day || fast.month != slow.month ||
+                           fast.year != slow.year || fast.minute != slow.minute))
+                consistent = false;
+        }
+    }
+    REQUIRE(consistent);
+
+    // Rows with a bad timestamp are dirty
+    writeFile("g1.csv", {
+        HDR,
+        "1,ZONE_A,ZX,2024-01-01 09:15,1,1",
+        "2,ZONE_A,ZX,x5:00,1,1",
+        "3,ZONE_A,ZX,2024-02-30 09:15,1,1",
+        "4,ZONE_A,ZX,2024-01-01 9:15,1,1"
+    });
+    TripAnalyzer ta;
+    ta.ingestFile("g1.csv");
+    REQUIRE(hasZone(ta.topZones(), "ZONE_A", 2));
+    REQUIRE(hasSlot(ta.topBusySlots(), "ZONE_A", 9, 2));
+    std::remove("g1.csv");
+}
+
+TEST_CASE("G2", "[G2]") {
+    // Civil dates <-> day numbers, checked against known values
+    REQUIRE(daysFromCivil(1970, 1, 1) == 0);
+    REQUIRE(daysFromCivil(1969, 12, 31) == -1);
+    REQUIRE(daysFromCivil(2000, 3, 1) == 11017);
+    REQUIRE(daysFromCivil(2024, 1, 1) == 19723);
+    REQUIRE(daysFromCivil(0, 1, 1) == -719528);
+
+    Timestamp t{};
+    REQUIRE(parseTimestamp("2024-01-01 10:30", t));
+    REQUIRE(epochMinutes(t) == 19723LL * 1440 + 630);
+    REQUIRE(formatMinute(epochMinutes(t)) == "2024-01-01 10:30");
+
+    // Every day from year 0 to 9999 survives the round trip
+    bool roundTrip = true;
+    int64_t expectDay = daysFromCivil(0, 1, 1);
+    for (int64_t day = expectDay; day <= daysFromCivil(9999, 12, 31); ++day) {
+        Timestamp back = fromEpochMinutes(day * 1440 + 59);
+        if (daysFromCivil(back.year, back.month, back.day) != day || back.hour != 0 || back.minute != 59)
+            roundTrip = false;
+    }
+    REQUIRE(roundTrip);
+    REQUIRE(formatDay(daysFromCivil(1600, 2, 29)) == "1600-02-29");
+
+    // Per-day and per-minute aggregates
+    std::string text = std::string(HDR) + "\n";
+    for (int i = 0; i < 3000; ++i) {
+        int day = 1 + i % 3;
+        text += std::to_string(i) + ",ZONE_" + std::to_string(i % 5) + ",ZX,2024-03-0" +
+                std::to_string(day) + " " + std::to_string(i / 60 % 24) + ":" + std::to_string(10 + i % 50) + ",1,1\n";
+    }
+    text += "x,ZONE_PEAK,ZX,2024-02-29 08:15,1,1\n";
+    text += "y,ZONE_PEAK,ZX,2024-02-29 08:15,1,1\n";
+    {
+        std::ofstream out("g2.csv", std::ios::binary);
+        out << text;
+    }
+
+    TripAnalyzer plain;
+    plain.ingestFile("g2.csv");
+    REQUIRE(plain.tripsPerDay().empty());
+    REQUIRE(plain.busiestMinutes().empty());
+
+    AnalyzerOptions opts;
+    opts.trackDays = true;
+    opts.trackMinutes = true;
+    TripAnalyzer ta(opts);
+    ta.ingestFile("g2.csv");
+    REQUIRE(sameResults(plain, ta, 100));
+
+    auto days = ta.tripsPerDay();
+    REQUIRE(days.size() == 4);
+    REQUIRE(days[0].date == "2024-02-29");
+    REQUIRE(days[0].count == 2);
+    REQUIRE(days[1].date == "2024-03-01");
+    REQUIRE(days[1].count == 1000);
+
+    auto busiest = ta.busiestDays(2);
+    REQUIRE(busiest.size() == 2);
+    REQUIRE(busiest[0].date == "2024-03-01");  // three-way tie, date asc
+    REQUIRE(busiest[1].date == "2024-03-02");
+
+    auto zoneDays = ta.topZoneDays(1);
+    REQUIRE(zoneDays.size() == 1);
+    REQUIRE(zoneDays[0].zone == "ZONE_0");
+    REQUIRE(zoneDays[0].date == "2024-03-01");
+    REQUIRE(zoneDays[0].count == 200);
+
+    auto minutes = ta.busiestMinutes(3);
+    REQUIRE(minutes.size() == 3);
+    REQUIRE(minutes[0].minute == "2024-02-29 08:15");
+    REQUIRE(minutes[0].count == 2);
+
+    // Worker threads and merges carry the time series along
+    auto [threaded, merged] = threadsAndMerges("g2.csv", opts, ta);
+    REQUIRE(threaded.topZoneDays(50).size() == 16);
+    REQUIRE(threaded.busiestMinutes(5)[0].minute == "2024-02-29 08:15");
+    REQUIRE(merged.tripsPerDay()[1].count == 2000);
+
+    std::remove("g2.csv");
+}
+
+TEST_CASE("G3", "[G3]") {
+    // Strict fixed-point parsing, three decimals
+    long long v = -1;
+    REQUIRE(parseDecimal("12.5", v));
+    REQUIRE(v == 12500);
+    REQUIRE(parseDecimal(" 7.25\r", v));
+    REQUIRE(v == 7250);
+    REQUIRE(parseDecimal("0", v));
+    REQUIRE(v == 0);
+    REQUIRE(parseDecimal("3.14159", v));
+    REQUIRE(v == 3141);
+    REQUIRE(parseDecimal("999999999999.999", v));
+    REQUIRE(v == 999999999999999LL);
+
+    v = 42;
+    for (const char* bad : { "", " ", "-1", "+1", "1.", ".5", "1..2", "1,5", "1e3", "abc",
+                             "1 2", "0x10", "nan", "1000000000000" })
+        REQUIRE_FALSE(parseDecimal(bad, v));
+    REQUIRE(v == 42);
+
+    // The 8-byte fast path agrees with the scalar parser
+    bool agree = true;
+    for (const char* text : { "0", "7", "39.0", "102.0", "15.8", "12345.678", "123456", "1.2345",
+                              "1.", ".1", "1.2.3", "12a4", "00042.1", "99999", "9.99 ", "1,2", "-4.5" }) {
+        std::string row = "prefix--," + std::string(text);
+        const char* begin = row.data() + 9;
+        long long fast = -1, slow = -1;
+        bool a = parseDecimalField(row.data(), begin, row.data() + row.size(), fast);
+        bool b = parseDecimal(text, slow);
+        if (a != b || fast != slow)
+            agree = false;
+    }
+    REQUIRE(agree);
+
+    // Per-zone and per-(zone, hour) sums, minima and maxima
+    std::string text = std::string(HDR) + "\n";
+    text += "1,ZONE_A,ZX,2024-01-01 08:00,2.5,10.00\n";
+    text += "2,ZONE_A,ZX,2024-01-01 08:30,1.0,4.50\r\n";
+    text += "3,ZONE_A,ZX,2024-01-01 09:00,10,30\n";
+    text += "4,ZONE_B,ZX,2024-01-01 08:00,20.25,50.5,extra\n";
+    text += "5,ZONE_B,ZX,2024-01-01 08:00,1.5,-3\n";      // counted, no amounts
+    text += "6,ZONE_C,ZX,2024-01-01 23:00,abc,1\n";       // counted, no amounts
+    text += "7,ZONE_C,ZX,2024-01-01 23:00,0.4,0.75\n";
+    for (int i = 0; i < 2000; ++i)
+        text += "f" + std::to_string(i) + ",ZONE_" + std::to_string(i % 7) + ",ZX,2024-01-02 " +
+                std::to_string(i % 24) + ":00," + std::to_string(i % 13) + "." + std::to_string(i % 10) +
+                "," + std::to_string(i % 31) + ".25\n";
+    {
+        std::ofstream out("g3.csv", std::ios::binary);
+        out << text;
+    }
+
+    TripAnalyzer plain;
+    plain.ingestFile("g3.csv");
+    REQUIRE(plain.topZonesByRevenue().empty());
+
+    AnalyzerOptions opts;
+    opts.trackAmounts = true;
+    TripAnalyzer ta(opts);
+    ta.ingestFile("g3.csv");
+    REQUIRE(sameResults(plain, ta, 100));
+    REQUIRE(ta.rejectedAmounts() == 2);
+
+    TripAmounts a = ta.zoneAmounts("ZONE_A");
+    REQUIRE(a.trips == 3);
+    REQUIRE(a.distance.sum == 13500);
+    REQUIRE(a.distance.min == 1000);
+    REQUIRE(a.distance.max == 10000);
+    REQUIRE(a.fare.sum == 44500);
+    REQUIRE(a.fare.min == 4500);
+    REQUIRE(a.fare.max == 30000);
+
+    TripAmounts a8 = ta.zoneAmounts("ZONE_A", 8);
+    REQUIRE(a8.trips == 2);
+    REQUIRE(a8.fare.sum == 14500);
+    REQUIRE(a8.distance.max == 2500);
+    REQUIRE(ta.zoneAmounts("ZONE_A", 9).fare.sum == 30000);
+    REQUIRE(ta.zoneAmounts("ZONE_B", 8).trips == 1);
+    REQUIRE(ta.zoneAmounts("ZONE_C").fare.min == 750);
+    REQUIRE(ta.zoneAmounts("NOPE").trips == 0);
+    REQUIRE(ta.zoneAmounts("ZONE_A", 24).trips == 0);
+
+    // Rankings match a brute-force sum over the generated rows
+    long long fares[7] = {}, km[7] = {};
+    for (int i = 0; i < 2000; ++i) {
+        fares[i % 7] += (i % 31) * 1000 + 250;
+        km[i % 7] += (i % 13) * 1000 + (i % 10) * 100;
+    }
+    auto revenue = ta.topZonesByRevenue(50);
+    auto distance = ta.topZonesByDistance(50);
+    REQUIRE(revenue.size() == 10);
+    REQUIRE(distance.size() == 10);
+    for (size_t i = 1; i < revenue.size(); ++i) {
+        REQUIRE(revenue[i - 1].amount.sum >= revenue[i].amount.sum);
+        REQUIRE(distance[i - 1].amount.sum >= distance[i].amount.sum);
+    }
+    for (const ZoneAmount& z : revenue)
+        if (z.zone.size() == 6 && z.zone[5] >= '0' && z.zone[5] <= '6')
+            REQUIRE(z.amount.sum == fares[z.zone[5] - '0']);
+    for (const ZoneAmount& z : distance)
+        if (z.zone.size() == 6 && z.zone[5] >= '0' && z.zone[5] <= '6')
+            REQUIRE(z.amount.sum == km[z.zone[5] - '0']);
+
+    // Worker threads and merges give the same totals
+    auto [threaded, merged] = threadsAndMerges("g3.csv", opts, ta);
+    auto threadedRevenue = threaded.topZonesByRevenue(50);
+    REQUIRE(threadedRevenue.size() == revenue.size());
+    for (size_t i = 0; i < revenue.size(); ++i) {
+        REQUIRE(threadedRevenue[i].zone == revenue[i].zone);
+        REQUIRE(threadedRevenue[i].trips == revenue[i].trips);
+        REQUIRE(threadedRevenue[i].amount.sum == revenue[i].amount.sum);
+        REQUIRE(threadedRevenue[i].amount.min == revenue[i].amount.min);
+        REQUIRE(threadedRevenue[i].amount.max == revenue[i].amount.max);
+    }
+    REQUIRE(threaded.rejectedAmounts() == 2);
+    REQUIRE(merged.zoneAmounts("ZONE_A", 8).fare.sum == 29000);
+    REQUIRE(merged.zoneAmounts("ZONE_A").distance.min == 1000);
+    REQUIRE(merged.rejectedAmounts() == 4);
+
+    std::remove("g3.csv");
+}
+
+TEST_CASE("G4", "[G4]") {
+    std::string text = std::string(HDR) + "\n";
+    text += "1,ZONE_A,ZONE_B,2024-01-01 08:00,1,1\n";
+    text += "2,ZONE_A,ZONE_B,2024-01-01 09:00,1,1\n";
+    text += "3,ZONE_A, ZONE_C ,2024-01-01 09:00,1,1\n";
+    text += "4,ZONE_B,ZONE_A,2024-01-01 09:00,1,1\n";
+    text += "5,ZONE_B,,2024-01-01 09:00,1,1\n";          // a trip, not a route
+    text += "6,ZONE_A,DROP_ONLY,2024-01-01 09:00,1,1\n";
+    text += "7,ZONE_A,DROP_ONLY,2024-01-01 25:00,1,1\n"; // dirty
+    // 300 origins x 200 destinations, a route per (i % 300, i % 200)
+    for (int i = 0; i < 6000; ++i)
+        text += "r" + std::to_string(i) + ",O" + std::to_string(i % 300) + ",D" + std::to_string(i % 200) +
+                ",2024-01-01 10:00,1,1\n";
+    {
+        std::ofstream out("g4.csv", std::ios::binary);
+        out << text;
+    }
+
+    TripAnalyzer plain;
+    plain.ingestFile("g4.csv");
+    REQUIRE(plain.topRoutes().empty());
+
+    AnalyzerOptions opts;
+    opts.trackRoutes = true;
+    TripAnalyzer ta(opts);
+    ta.ingestFile("g4.csv");
+
+    // Dropoff-only zones never become pickup zones
+    REQUIRE(sameResults(plain, ta, 1000));
+    for (const auto& z : ta.topZones(1000))
+        REQUIRE(z.zone != "DROP_ONLY");
+
+    auto routes = ta.topRoutes(3);
+    REQUIRE(routes.size() == 3);
+    REQUIRE(routes[0].origin == "O0");        // (0, 0) repeats every 600 rows
+    REQUIRE(routes[0].destination == "D0");
+    REQUIRE(routes[0].count == 10);
+    REQUIRE(routes[1].origin == "O0");
+    REQUIRE(routes[1].destination == "D100");
+    REQUIRE(routes[2].origin == "O1");
+
+    auto fromA = ta.topDestinationsFrom("ZONE_A");
+    REQUIRE(fromA.size() == 3);
+    REQUIRE(fromA[0].destination == "ZONE_B");
+    REQUIRE(fromA[0].count == 2);
+    REQUIRE(fromA[1].destination == "DROP_ONLY");
+    REQUIRE(fromA[2].destination == "ZONE_C");
+    REQUIRE(ta.topDestinationsFrom("ZONE_B").size() == 1);
+    REQUIRE(ta.topDestinationsFrom("DROP_ONLY").empty());
+    REQUIRE(ta.topDestinationsFrom("O7", 100).size() == 2);
+
+    // 600 distinct generated routes plus the hand-written ones
+    REQUIRE(ta.topRoutes(10000).size() == 604);
+
+    // Threads and merges remap both ends of every route
+    auto [threaded, merged] = threadsAndMerges("g4.csv", opts, ta);
+    auto all = ta.topRoutes(10000);
+    auto threadedAll = threaded.topRoutes(10000);
+    REQUIRE(threadedAll.size() == all.size());
+    bool same = true;
+    for (size_t i = 0; i < all.size(); ++i)
+        if (all[i].origin != threadedAll[i].origin || all[i].destination != threadedAll[i].destination ||
+            all[i].count != threadedAll[i].count)
+            same = false;
+    REQUIRE(same);
+    REQUIRE(merged.topRoutes(1)[0].count == 20);
+    REQUIRE(merged.topDestinationsFrom("ZONE_A")[0].count == 4);
+
+    std::remove("g4.csv");
+}
+
+TEST_CASE("G5", "[G5]") {
+    // 2024-01-01 was a Monday, 2024-01-07 a Sunday
+    std::string text = std::string(HDR) + "\n";
+    for (int i = 0; i < 5; ++i)
+        text += "m" + std::to_string(i) + ",ZONE_A,ZX,2024-01-01 08:15,1,1\n";
+    for (int i = 0; i < 2; ++i)
+        text += "s" + std::to_string(i) + ",ZONE_A,ZX,2024-01-07 08:45,1,1\n";
+    text += "x,ZONE_A,ZX,2024-01-08 08:00,1,1\n";   // next Monday, same bucket
+    text += "y,ZONE_B,ZX,1969-12-31 23:59,1,1\n";   // Wednesday, before 1970
+    for (int i = 0; i < 1000; ++i)
+        text += "r" + std::to_string(i) + ",Z" + std::to_string(i % 11) + ",ZX,2024-02-" +
+                std::to_string(10 + i % 14) + " " + std::to_string(i % 24) + ":30,1,1\n";
+    {
+        std::ofstream out("g5.csv", std::ios::binary);
+        out << text;
+    }
+
+    TripAnalyzer plain;
+    plain.ingestFile("g5.csv");
+    REQUIRE(plain.topWeeklySlots().empty());
+
+    AnalyzerOptions opts;
+    opts.trackWeekdays = true;
+    TripAnalyzer ta(opts);
+    ta.ingestFile("g5.csv");
+    REQUIRE(sameResults(plain, ta, 100));
+
+    // The hour slot merges the Monday and Sunday 08:00 trips...
+    auto hourly = ta.topBusySlots(1);
+    REQUIRE(hourly[0].zone == "ZONE_A");
+    REQUIRE(hourly[0].count == 8);
+
+    // ...the weekly slots keep them apart
+    auto weekly = ta.topWeeklySlots(3000);
+    REQUIRE(weekly[0].zone == "ZONE_A");
+    REQUIRE(weekly[0].weekday == 0);
+    REQUIRE(weekly[0].hour == 8);
+    REQUIRE(weekly[0].count == 6);
+
+    bool sunday = false, wednesday = false;
+    long long total = 0;
+    for (const auto& w : weekly) {
+        total += w.count;
+        if (w.zone == "ZONE_A" && w.weekday == 6 && w.hour == 8 && w.count == 2)
+            sunday = true;
+        if (w.zone == "ZONE_B" && w.weekday == 2 && w.hour == 23 && w.count == 1)
+            wednesday = true;
+    }
+    REQUIRE(sunday);
+    REQUIRE(wednesday);
+    REQUIRE(total == 1009);
+
+    // Ties: count desc, zone asc, weekday asc, hour asc
+    for (size_t i = 1; i < weekly.size(); ++i) {
+        const auto& a = weekly[i - 1];
+        const auto& b = weekly[i];
+        REQUIRE(std::make_tuple(-a.count, a.zone, a.weekday, a.hour) <
+                std::make_tuple(-b.count, b.zone, b.weekday, b.hour));
+    }
+
+    // Threads and merges
+    auto [threaded, merged] = threadsAndMerges("g5.csv", opts, ta);
+    auto threadedWeekly = threaded.topWeeklySlots(3000);
+    REQUIRE(threadedWeekly.size() == weekly.size());
+    for (size_t i = 0; i < weekly.size(); ++i) {
+        REQUIRE(threadedWeekly[i].zone == weekly[i].zone);
+        REQUIRE(threadedWeekly[i].weekday == weekly[i].weekday);
+        REQUIRE(threadedWeekly[i].hour == weekly[i].hour);
+        REQUIRE(threadedWeekly[i].count == weekly[i].count);
+    }
+    REQUIRE(merged.topWeeklySlots(1)[0].count == 12);
+
+    std::remove("g5.csv");
+}
+
+TEST_CASE("G6", "[G6]") {
+    static_assert(HourSlots::kSlots == 24 && QuarterHourSlots::kSlots == 96 && FiveMinuteSlots::kSlots == 288);
+    static_assert(sizeof(SlotArray<FiveMinuteSlots>) == 288 * sizeof(long long));
+
+    std::string text = std::string(HDR) + "\n";
+    for (int i = 0; i < 4; ++i)
+        text += "a" + std::to_string(i) + ",ZONE_A,ZX,2024-01-01 08:07,1,1\n";   // 08:00 / 08:05
+    for (int i = 0; i < 4; ++i)
+        text += "b" + std::to_string(i) + ",ZONE_B,ZX,2024-01-01 08:14,1,1\n";   // 08:00 / 08:10
+    for (int i = 0; i < 4; ++i)
+        text += "c" + std::to_string(i) + ",ZONE_B,ZX,2024-01-01 08:59,1,1\n";   // 08:45 / 08:55
+    text += "d,ZONE_C,ZX,2024-01-01 23:59,1,1\n";
+    for (int i = 0; i < 1440; ++i)
+        text += "r" + std::to_string(i) + ",Z" + std::to_string(i % 5) + ",ZX,2024-01-02 " +
+                std::to_string(i / 60) + ":" + (i % 60 < 10 ? "0" : "") + std::to_string(i % 60) + ",1,1\n";
+    {
+        std::ofstream out("g6.csv", std::ios::binary);
+        out << text;
+    }
+
+    TripAnalyzer plain;
+    plain.ingestFile("g6.csv");
+    REQUIRE(plain.topQuarterHourSlots().empty());
+    REQUIRE(plain.topFiveMinuteSlots().empty());
+
+    AnalyzerOptions opts;
+    opts.trackQuarterHours = true;
+    opts.trackFiveMinutes = true;
+    TripAnalyzer ta(opts);
+    ta.ingestFile("g6.csv");
+    REQUIRE(sameResults(plain, ta, 100));
+
+    // Hourly policy ranks the record's own hour counters like topBusySlots
+    auto hourly = ta.topSlots<HourSlots>(200);
+    auto busy = ta.topBusySlots(200);
+    REQUIRE(hourly.size() == busy.size());
+    for (size_t i = 0; i < busy.size(); ++i) {
+        REQUIRE(hourly[i].zone == busy[i].zone);
+        REQUIRE(hourly[i].minute == busy[i].hour * 60);
+        REQUIRE(hourly[i].count == busy[i].count);
+    }
+
+    auto quarter = ta.topQuarterHourSlots(3);
+    REQUIRE(quarter[0].zone == "ZONE_A");
+    REQUIRE(quarter[0].minute == 8 * 60);
+    REQUIRE(quarter[0].count == 4);
+    REQUIRE(quarter[1].zone == "ZONE_B");
+    REQUIRE(quarter[1].minute == 8 * 60);
+    REQUIRE(quarter[2].minute == 8 * 60 + 45);
+
+    auto five = ta.topFiveMinuteSlots(4);
+    REQUIRE(five[0].minute == 8 * 60 + 5);
+    REQUIRE(five[1].zone == "ZONE_B");
+    REQUIRE(five[1].minute == 8 * 60 + 10);
+    REQUIRE(five[2].minute == 8 * 60 + 55);
+    REQUIRE(five[3].count == 1);
+
+    // Every generated minute lands in exactly one slot of each width
+    auto allQuarter = ta.topQuarterHourSlots(100000);
+    auto allFive = ta.topFiveMinuteSlots(100000);
+    long long quarterSum = 0, fiveSum = 0;
+    for (const auto& s : allQuarter)
+        quarterSum += s.count;
+    for (const auto& s : allFive)
+        fiveSum += s.count;
+    REQUIRE(quarterSum == 1453);
+    REQUIRE(fiveSum == 1453);
+    REQUIRE(allFive.back().zone == "ZONE_C");
+    REQUIRE(allFive.back().minute == 23 * 60 + 55);
+
+    // Threads and merges
+    auto [threaded, merged] = threadsAndMerges("g6.csv", opts, ta);
+    REQUIRE(threaded.topFiveMinuteSlots(100000).size() == allFive.size());
+    REQUIRE(merged.topQuarterHourSlots(1)[0].count == 8);
+
+    std::remove("g6.csv");
+}
+
+TEST_CASE("G7", "[G7]") {
+    // Space-Saving guarantees, checked against exact counts
+    auto checkBounds = [](const SpaceSaving& s, const std::map<std::string, long long>& exact) {
+        bool ok = s.size() <= s.capacity() && s.minCount() <= s.total() / (long long)s.capacity();
+        std::map<std::string, bool> seen;
+        s.forEach([&](const SpaceSaving::Entry& e) {
+            auto it = exact.find(e.name);
+            long long truth = it == exact.end() ? 0 : it->second;
+            ok = ok && e.count - e.error <= truth && truth <= e.count && e.error <= s.minCount();
+            seen[e.name] = true;
+        });
+        for (const auto& [name, truth] : exact)
+            ok = ok && (truth <= s.minCount() || seen.count(name));
+        return ok;
+    };
+
+    // Skewed stream: a few hundred hot keys over 20K cold ones
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    std::vector<std::string> stream;
+    for (int i = 0; i < 60000; ++i) {
+        uint64_t r = next();
+        int key = r % 2 ? int(r / 2 % 300) % (1 + int(r / 1000 % 300)) : 1000 + int(r / 2 % 20000);
+        stream.push_back("K" + std::to_string(key));
+    }
+
+    SpaceSaving whole(200), left(200), right(200);
+    std::map<std::string, long long> exact;
+    for (size_t i = 0; i < stream.size(); ++i) {
+        whole.add(stream[i], -1);
+        (i < stream.size() / 2 ? left : right).add(stream[i], -1);
+        exact[stream[i]]++;
+    }
+    REQUIRE(whole.total() == 60000);
+    REQUIRE(whole.size() == 200);
+    REQUIRE(checkBounds(whole, exact));
+
+    left.merge(right);
+    REQUIRE(left.total() == 60000);
+    REQUIRE(checkBounds(left, exact));
+
+    SpaceSaving none;
+    none.add("x", 0);
+    REQUIRE(none.size() == 0);
+
+    // Analyzer: 10 busy zones among 20K junk zones, 256 entries each
+    std::string text = std::string(HDR) + "\n";
+    std::map<std::string, long long> zoneExact;
+    for (int i = 0; i < 40000; ++i) {
+        std::string zone = i % 2 ? "HOT_" + std::to_string(i % 20 / 2) : "JUNK_" + std::to_string(i / 2);
+        text += std::to_string(i) + "," + zone + ",ZX,2024-01-01 " + std::to_string(i % 24) + ":00,1,1\n";
+        zoneExact[zone]++;
+    }
+    text += "9,HOT_0,ZX,2024-01-01 25:00,1,1\n";   // still dirty
+    {
+        std::ofstream out("g7.csv", std::ios::binary);
+        out << text;
+    }
+
+    TripAnalyzer exactTa;
+    exactTa.ingestFile("g7.csv");
+    REQUIRE(exactTa.heavyHitterBounds().rows == 0);
+
+    AnalyzerOptions opts;
+    opts.heavyHitterCapacity = 256;
+    TripAnalyzer approx(opts);
+    approx.ingestFile("g7.csv");
+
+    HeavyHitterBounds bounds = approx.heavyHitterBounds();
+    REQUIRE(bounds.rows == 40000);
+    REQUIRE(bounds.zoneError <= 40000 / 256);
+    REQUIRE(bounds.slotError <= 40000 / 256);
+
+    auto truth = exactTa.topZones(10);
+    auto estimate = approx.topZones(10);
+    REQUIRE(estimate.size() == 10);
+    for (size_t i = 0; i < truth.size(); ++i) {
+        REQUIRE(estimate[i].zone == truth[i].zone);
+        REQUIRE(estimate[i].count >= truth[i].count);
+        REQUIRE(estimate[i].count - bounds.zoneError <= truth[i].count);
+    }
+    REQUIRE(approx.topZones(100000).size() == 256);
+
+    // Slots: HOT_n only ever sees the hours of i with i % 20 == 2n + 1
+    auto slots = approx.topBusySlots(10);
+    auto exactSlots = exactTa.topBusySlots(10);
+    REQUIRE(slots.size() == 10);
+    for (size_t i = 0; i < slots.size(); ++i) {
+        REQUIRE(slots[i].zone.rfind("HOT_", 0) == 0);
+        REQUIRE(slots[i].count >= exactSlots.back().count);
+        REQUIRE(slots[i].count - bounds.slotError <= exactSlots.front().count);
+    }
+
+    // Worker tables are merged summaries, bounds still hold
+    opts.threads = 4;
+    opts.minChunkBytes = 4096;
+    TripAnalyzer threaded(opts);
+    threaded.ingestFile("g7.csv");
+    HeavyHitterBounds threadedBounds = threaded.heavyHitterBounds();
+    REQUIRE(threadedBounds.rows == 40000);
+    auto threadedTop = threaded.topZones(10);
+    for (size_t i = 0; i < truth.size(); ++i) {
+        REQUIRE(threadedTop[i].zone == truth[i].zone);
+        REQUIRE(threadedTop[i].count >= truth[i].count);
+        REQUIRE(threadedTop[i].count - threadedBounds.zoneError <= truth[i].count);
+    }
+
+    // Checkpoints can't hold the summaries, so a checkpoint left by an
+    // exact run isn't resumed and none is written
+    size_t half = text.find('\n', text.size() / 2) + 1;
+    ZoneStatsTable partial;
+    partial.add("HOT_0", 3);
+    CheckpointSource source;
+    REQUIRE(checkpointSource("g7.csv", source));
+    REQUIRE(writeCheckpointFile("g7.ckpt", source, half, partial));
+
+    opts.checkpointPath = "g7.ckpt";
+    opts.checkpointEveryBytes = 4096;
+    TripAnalyzer checkpointed(opts);
+    checkpointed.ingestFile("g7.csv");
+    REQUIRE(checkpointed.heavyHitterBounds().rows == 40000);
+    auto checkpointedTop = checkpointed.topZones(100);
+    auto threadedAll = threaded.topZones(100);
+    REQUIRE(checkpointedTop.size() == threadedAll.size());
+    for (size_t i = 0; i < checkpointedTop.size(); ++i) {
+        REQUIRE(checkpointedTop[i].zone == threadedAll[i].zone);
+        REQUIRE(checkpointedTop[i].count == threadedAll[i].count);
+    }
+    REQUIRE(std::ifstream("g7.ckpt").good());
+
+    // Snapshots and exact merges would drop the summaries, they are refused
+    TripAnalyzer plain;
+    plain.ingestFile("g7.csv");
+    REQUIRE_FALSE(threaded.saveSnapshot("g7.snap"));
+    REQUIRE_FALSE(std::ifstream("g7.snap").good());
+    REQUIRE(threaded.exportAggregates().empty());
+    REQUIRE(plain.saveSnapshot("g7.snap"));
+    REQUIRE_FALSE(threaded.loadSnapshot("g7.snap"));
+    REQUIRE_FALSE(threaded.mergeAggregates(plain.exportAggregates()));
+    REQUIRE_FALSE(threaded.merge(plain));
+    REQUIRE_FALSE(plain.merge(threaded));
+    REQUIRE(threaded.heavyHitterBounds().rows == 40000);
+    REQUIRE(plain.topZones(1)[0].count == truth[0].count);
+    REQUIRE(checkpointed.merge(std::move(threaded)));
+    REQUIRE(checkpointed.heavyHitterBounds().rows == 80000);
+
+    std::remove("g7.snap");
+    std::remove("g7.ckpt");
+    std::remove("g7.csv");
+}
+
+TEST_CASE("G8", "[G8]") {
+    // Dimensions from epsilon and delta
+    size_t width = 0, depth = 0;
+    CountMinSketch::dimensions(0.001, 0.01, width, depth);
+    REQUIRE(width == 4096);   // e / 0.001 = 2718.3, next power of two
+    REQUIRE(depth == 5);      // ln(100) = 4.6
+    CountMinSketch::dimensions(0, 0.01, width, depth);
+    REQUIRE(width == 0);
+
+    // Two halves of a skewed feed over 2000 zones
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    std::string halves[2] = { std::string(HDR) + "\n", std::string(HDR) + "\n" };
+    for (int i = 0; i < 40000; ++i) {
+        uint64_t r = next();
+        int zone = int(r % 2000 % (1 + (r >> 16) % 2000));
+        halves[i % 2] += std::to_string(i) + ",Z" + std::to_string(zone) + ",ZX,2024-01-01 " +
+                         std::to_string((r >> 40) % 24) + ":00,1,1\n";
+    }
+    for (int h = 0; h < 2; ++h) {
+        std::ofstream out("g8_" + std::to_string(h) + ".csv", std::ios::binary);
+        out << halves[h];
+    }
+
+    TripAnalyzer exact;
+    exact.ingestFile("g8_0.csv");
+    exact.ingestFile("g8_1.csv");
+    REQUIRE(exact.sketchError() == 0);
+    REQUIRE(exact.exportSketch().size() > 0);
+
+    AnalyzerOptions opts;
+    opts.sketchEpsilon = 0.001;
+    opts.sketchDelta = 0.01;
+    TripAnalyzer whole(opts), left(opts), right(opts);
+    whole.ingestFile("g8_0.csv");
+    whole.ingestFile("g8_1.csv");
+    left.ingestFile("g8_0.csv");
+    right.ingestFile("g8_1.csv");
+
+    // Exact counts still come out of the tables
+    REQUIRE(sameResults(exact, whole, 100));
+    long long bound = whole.sketchError();
+    REQUIRE(bound == 27);    // ceil(e * 40000 / 4096)
+
+    // Never under, over by more than epsilon * N for at most delta of them
+    auto slots = exact.topBusySlots(48000);
+    int under = 0, over = 0;
+    for (const auto& s : slots) {
+        long long est = whole.estimateSlot(s.zone, s.hour);
+        if (est < s.count)
+            under++;
+        if (est - s.count > bound)
+            over++;
+        REQUIRE(exact.estimateSlot(s.zone, s.hour) == s.count);
+    }
+    REQUIRE(under == 0);
+    REQUIRE(over <= int(slots.size() / 100));
+    REQUIRE(whole.estimateSlot("Z0", 24) == 0);
+
+    // Merged in process and shipped as bytes: counters just add
+    TripAnalyzer merged(opts);
+    merged.merge(left);
+    merged.merge(TripAnalyzer(right));
+    TripAnalyzer shipped(opts);
+    REQUIRE(shipped.mergeSketch(left.exportSketch()));
+    REQUIRE(shipped.mergeSketch(right.exportSketch()));
+    bool same = true;
+    for (size_t i = 0; i < slots.size(); i += 7) {
+        long long est = whole.estimateSlot(slots[i].zone, slots[i].hour);
+        same = same && merged.estimateSlot(slots[i].zone, slots[i].hour) == est &&
+               shipped.estimateSlot(slots[i].zone, slots[i].hour) == est;
+    }
+    REQUIRE(same);
+    REQUIRE(shipped.sketchError() == bound);
+
+    // Other dimensions and damaged bytes are refused
+    AnalyzerOptions coarse = opts;
+    coarse.sketchEpsilon = 0.01;
+    TripAnalyzer other(coarse);
+    other.ingestFile("g8_0.csv");
+    REQUIRE_FALSE(shipped.mergeSketch(other.exportSketch()));
+    std::string bytes = left.exportSketch();
+    bytes[bytes.size() / 2] ^= 1;
+    REQUIRE_FALSE(shipped.mergeSketch(bytes));
+    REQUIRE_FALSE(shipped.mergeSketch("TRIPCMSK"));
+    REQUIRE(shipped.sketchError() == bound);
+
+    // Rows that arrive as records (snapshots, exported aggregates) are
+    // added to the sketch too, same counters as row by row
+    REQUIRE(exact.saveSnapshot("g8.snap"));
+    TripAnalyzer loaded(opts), viaBytes(opts);
+    REQUIRE(loaded.loadSnapshot("g8.snap"));
+    viaBytes.ingestFile("g8_0.csv");
+    REQUIRE(viaBytes.mergeAggregates(right.exportAggregates()));
+    REQUIRE(loaded.sketchError() == bound);
+    REQUIRE(viaBytes.sketchError() == bound);
+    int differ = 0;
+    for (const auto& s : slots) {
+        long long est = whole.estimateSlot(s.zone, s.hour);
+        differ += loaded.estimateSlot(s.zone, s.hour) != est;
+        differ += viaBytes.estimateSlot(s.zone, s.hour) != est;
+    }
+    REQUIRE(differ == 0);
+    std::remove("g8.snap");
+
+    // Approximate mode without a sketch answers from the slot summary
+    AnalyzerOptions summaryOnly;
+    summaryOnly.heavyHitterCapacity = 64;
+    TripAnalyzer summary(summaryOnly);
+    summary.ingestFile("g8_0.csv");
+    summary.ingestFile("g8_1.csv");
+    int below = 0;
+    for (const auto& s : slots)
+        below += summary.estimateSlot(s.zone, s.hour) < s.count;
+    REQUIRE(below == 0);
+    auto topSlot = summary.topBusySlots(1)[0];
+    REQUIRE(summary.estimateSlot(topSlot.zone, topSlot.hour) == topSlot.count);
+    REQUIRE(summary.estimateSlot("Z_NONE", 3) == summary.heavyHitterBounds().slotError);
+
+    // A sketch also rides along with the approximate mode
+    opts.heavyHitterCapacity = 64;
+    opts.threads = 4;
+    opts.minChunkBytes = 4096;
+    TripAnalyzer approx(opts);
+    approx.ingestFile("g8_0.csv");
+    approx.ingestFile("g8_1.csv");
+    REQUIRE(approx.estimateSlot(slots[0].zone, slots[0].hour) ==
+            whole.estimateSlot(slots[0].zone, slots[0].hour));
+
+    std::remove("g8_0.csv");
+    std::remove("g8_1.csv");
+}
+
+TEST_CASE("G9", "[G9]") {
+    // Numeric ids are the text itself, other ids fall back to strings
+    uint64_t id = 0;
+    REQUIRE(TripIdFilter::parseTripId("0", id));
+    REQUIRE(id == 0);
+    REQUIRE(TripIdFilter::parseTripId("9999999999999999999", id));
+    REQUIRE(id == 9999999999999999999ull);
+    REQUIRE_FALSE(TripIdFilter::parseTripId("10000000000000000000", id));
+    REQUIRE_FALSE(TripIdFilter::parseTripId("007", id));
+    REQUIRE_FALSE(TripIdFilter::parseTripId("12a", id));
+    REQUIRE_FALSE(TripIdFilter::parseTripId("-12", id));
+
+    TripIdFilter filter;
+    REQUIRE_FALSE(filter.seen("7"));
+    REQUIRE_FALSE(filter.seen("007"));
+    REQUIRE_FALSE(filter.seen("T-7"));
+    REQUIRE(filter.seen("7"));
+    REQUIRE(filter.seen("007"));
+    REQUIRE(filter.seen("T-7"));
+    REQUIRE(filter.duplicates() == 3);
+    REQUIRE(filter.size() == 3);
+
+    // Enough ids to grow the Bloom filter several times, none lost
+    TripIdFilter many;
+    int wrong = 0;
+    for (uint64_t i = 0; i < 200000; ++i)
+        wrong += many.seen(std::to_string(1000000 + i * 7919));
+    for (uint64_t i = 0; i < 200000; i += 3)
+        wrong += !many.seen(std::to_string(1000000 + i * 7919));
+    REQUIRE(wrong == 0);
+    REQUIRE(many.size() == 200000);
+    REQUIRE(many.duplicates() == 66667);
+    REQUIRE(many.falsePositives() < 2000);
+
+    // Ids out of order go to the exact set, repeats of both kinds are found
+    TripIdFilter mixed;
+    mixed.reserve(1000);
+    wrong = 0;
+    for (uint64_t i = 0; i < 30000; ++i)
+        wrong += mixed.seen(std::to_string(i % 3 == 2 ? 900000 - i : 100 + i));
+    for (uint64_t i = 0; i < 30000; ++i)
+        wrong += !mixed.seen(std::to_string(i % 3 == 2 ? 900000 - i : 100 + i));
+    REQUIRE(wrong == 0);
+    REQUIRE(mixed.duplicates() == 30000);
+    REQUIRE(mixed.size() == 30000);
+
+    // A feed, then the same feed with its second half replayed
+    std::string rows;
+    for (int i = 0; i < 3000; ++i)
+        rows += (i % 10 == 0 ? "T" : "") + std::to_string(100000 + i) + ",Z" + std::to_string(i % 37) +
+                ",ZX,2024-03-0" + std::to_string(1 + i % 7) + " " + std::to_string(i % 24) + ":15,1.5,9\n";
+    std::string replay = rows.substr(rows.size() / 2);
+    replay = replay.substr(replay.find('\n') + 1);
+    {
+        std::ofstream out("g9_a.csv", std::ios::binary);
+        out << HDR << "\n" << rows;
+    }
+    {
+        std::ofstream out("g9_b.csv", std::ios::binary);
+        out << HDR << "\n" << replay
+            << "  100001 ,Z1,ZX,2024-03-02 01:15,1,1\n"   // trimmed like every id
+            << "555,Z5,ZX,not a time,1,1\n"              // dirty, its id isn't taken
+            << "555,Z5,ZX,2024-03-02 05:00,1,1\n"
+            << "555,Z5,ZX,2024-03-02 05:00,1,1\n";
+    }
+    long long replayed = std::count(replay.begin(), replay.end(), '\n');
+
+    TripAnalyzer plain;
+    plain.ingestFile("g9_a.csv");
+    std::istringstream kept(std::string(HDR) + "\n555,Z5,ZX,2024-03-02 05:00,1,1\n");
+    plain.ingestStream(kept);
+
+    AnalyzerOptions opts;
+    opts.dedupeTripIds = true;
+    TripAnalyzer deduped(opts);
+    deduped.ingestFile("g9_a.csv");
+    REQUIRE(deduped.duplicateTrips() == 0);
+    deduped.ingestFile("g9_b.csv");
+    REQUIRE(sameResults(plain, deduped, 100));
+    REQUIRE(deduped.duplicateTrips() == replayed + 2);
+
+    // Without the option the replay is counted twice
+    TripAnalyzer doubled;
+    doubled.ingestFile("g9_a.csv");
+    doubled.ingestFile("g9_b.csv");
+    REQUIRE(doubled.duplicateTrips() == 0);
+    REQUIRE(doubled.topZones(1)[0].count > plain.topZones(1)[0].count);
+
+    // Threads, several files and streams all keep the first copy
+    opts.threads = 4;
+    opts.minChunkBytes = 4096;
+    TripAnalyzer threaded(opts);
+    threaded.ingestFiles({ "g9_a.csv", "g9_b.csv" });
+    REQUIRE(sameResults(plain, threaded, 100));
+    REQUIRE(threaded.duplicateTrips() == replayed + 2);
+
+    opts.readBlockBytes = 256;
+    TripAnalyzer streamed(opts);
+    std::ifstream a("g9_a.csv", std::ios::binary), b("g9_b.csv", std::ios::binary);
+    streamed.ingestStream(a);
+    streamed.ingestStream(b);
+    REQUIRE(sameResults(plain, streamed, 100));
+
+    // A checkpoint doesn't hold the ids, so one left for the replay isn't
+    // resumed: its rows would skip the filter
+    ZoneStatsTable partial;
+    partial.add("ZONE_MARK", 3);
+    CheckpointSource source;
+    REQUIRE(checkpointSource("g9_b.csv", source));
+    REQUIRE(writeCheckpointFile("g9.ckpt", source, replay.size() / 2, partial));
+    AnalyzerOptions ckptOpts;
+    ckptOpts.dedupeTripIds = true;
+    ckptOpts.checkpointPath = "g9.ckpt";
+    ckptOpts.checkpointEveryBytes = 1024;
+    TripAnalyzer checkpointed(ckptOpts);
+    checkpointed.ingestFile("g9_a.csv");
+    checkpointed.ingestFile("g9_b.csv");
+    REQUIRE(sameResults(plain, checkpointed, 100));
+    REQUIRE(checkpointed.duplicateTrips() == replayed + 2);
+    REQUIRE(std::ifstream("g9.ckpt").good());
+
+    std::remove("g9.ckpt");
+    std::remove("g9_a.csv");
+    std::remove("g9_b.csv");
+}
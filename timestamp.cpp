@@ -0,0 +1,135 @@
+#include "timestamp.h"
+#include <cstdio>
+
+using namespace std;
+
+namespace {
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// Reads minDigits..maxDigits digits at pos
+bool readNumber(string_view s, size_t& pos, int minDigits, int maxDigits, int& value)
+{
+    int digits = 0;
+    value = 0;
+    while (pos < s.size() && digits < maxDigits && isDigit(s[pos]))
+    {
+        value = value * 10 + (s[pos] - '0');
+        pos++;
+        digits++;
+    }
+
+    // A longer run of digits than allowed isn't this field
+    if (pos < s.size() && isDigit(s[pos]))
+        return false;
+
+    return digits >= minDigits;
+}
+
+bool expect(string_view s, size_t& pos, char c)
+{
+    if (pos >= s.size() || s[pos] != c)
+        return false;
+    pos++;
+    return true;
+}
+
+} // namespace
+
+bool parseTimestampSlow(string_view s, Timestamp& out)
+{
+    while (!s.empty() && (isBlank(s.front()) || s.front() == '\r'))
+        s.remove_prefix(1);
+    while (!s.empty() && (isBlank(s.back()) || s.back() == '\r'))
+        s.remove_suffix(1);
+
+    if (s.size() == 16 && parseTimestampFixed(s.data(), out))
+        return true;
+
+    Timestamp t;
+    size_t pos = 0;
+
+    if (!readNumber(s, pos, 4, 4, t.year) || !expect(s, pos, '-') ||
+        !readNumber(s, pos, 1, 2, t.month) || !expect(s, pos, '-') ||
+        !readNumber(s, pos, 1, 2, t.day))
+        return false;
+
+    // ISO 'T', or any run of spaces
+    if (pos < s.size() && s[pos] == 'T')
+    {
+        pos++;
+    }
+    else
+    {
+        size_t blanks = pos;
+        while (pos < s.size() && isBlank(s[pos]))
+            pos++;
+        if (pos == blanks)
+            return false;
+    }
+
+    if (!readNumber(s, pos, 1, 2, t.hour) || !expect(s, pos, ':') ||
+        !readNumber(s, pos, 2, 2, t.minute))
+        return false;
+
+    // Seconds are checked but not kept
+    if (pos < s.size())
+    {
+        int seconds = 0;
+        if (!expect(s, pos, ':') || !readNumber(s, pos, 2, 2, seconds) || seconds > 59)
+            return false;
+    }
+
+    if (pos != s.size() || !timestamp_detail::validFields(t))
+        return false;
+
+    out = t;
+    return true;
+}
+
+Timestamp fromEpochMinutes(int64_t minutes)
+{
+    // Floor division, so minutes before 1970 land in the right day
+    int64_t days = minutes >= 0 ? minutes / 1440 : -((-minutes + 1439) / 1440);
+    int minuteOfDay = static_cast<int>(minutes - days * 1440);
+
+    // civil_from_days, the inverse of daysFromCivil
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    const unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const unsigned mp = (5 * dayOfYear + 2) / 153;
+
+    Timestamp t;
+    t.day = static_cast<int>(dayOfYear - (153 * mp + 2) / 5 + 1);
+    t.month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    t.year = static_cast<int>(int64_t(yearOfEra) + era * 400 + (t.month <= 2));
+    t.hour = minuteOfDay / 60;
+    t.minute = minuteOfDay % 60;
+    return t;
+}
+
+string formatDay(int64_t day)
+{
+    Timestamp t = fromEpochMinutes(day * 1440);
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%04d-%02d-%02d", t.year, t.month, t.day);
+    return buf;
+}
+
+string formatMinute(int64_t minutes)
+{
+    Timestamp t = fromEpochMinutes(minutes);
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d", t.year, t.month, t.day, t.hour, t.minute);
+    return buf;
+}
@@ -0,0 +1,167 @@
+#pragma once // prevents multiple inclusions
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Calendar fields of a PickupDateTime value
+struct Timestamp {
+    int year;    // 0–9999
+    int month;   // 1–12
+    int day;     // 1–days in that month
+    int hour;    // 0–23
+    int minute;  // 0–59
+};
+
+namespace timestamp_detail {
+
+// One byte per character of an 8-character layout, 'd' marks a digit
+// digit goes in digit positions, other in the rest (-1: the layout character)
+constexpr std::uint64_t layoutWord(const char* layout, unsigned digit, int other)
+{
+    std::uint64_t word = 0;
+    for (int i = 7; i >= 0; --i)
+    {
+        unsigned byte = layout[i] == 'd' ? digit
+                      : other < 0 ? static_cast<unsigned char>(layout[i])
+                      : static_cast<unsigned>(other);
+        word = (word << 8) | byte;
+    }
+    return word;
+}
+
+// 8 bytes in string order, first character in the low byte
+inline std::uint64_t loadWord(const char* p)
+{
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// Checks one 8-character layout: digits where it says 'd', the literal
+// character everywhere else. A digit is 0x3? with a low nibble below 10,
+// so adding 6 must not carry out of the nibble
+struct LayoutCheck {
+    std::uint64_t mask, pattern, bump, nibble, high;
+
+    constexpr explicit LayoutCheck(const char* layout)
+        : mask(layoutWord(layout, 0xF0, 0xFF)),
+          pattern(layoutWord(layout, 0x30, -1)),
+          bump(layoutWord(layout, 0x06, 0)),
+          nibble(layoutWord(layout, 0xF0, 0)),
+          high(layoutWord(layout, 0x30, 0))
+    {
+    }
+
+    // Zero iff word matches
+    std::uint64_t mismatch(std::uint64_t word) const
+    {
+        return ((word & mask) ^ pattern) | (((word + bump) & nibble) ^ high);
+    }
+};
+
+constexpr LayoutCheck kDateLayout("dddd-dd-");
+constexpr LayoutCheck kTimeLayout("dd dd:dd");
+
+// Byte i becomes 10 * digit(i) + digit(i + 1), the value of the two-digit
+// number starting there. Every byte stays below 256 even for non-digits.
+inline std::uint64_t pairValues(std::uint64_t word)
+{
+    std::uint64_t digits = word & 0x0F0F0F0F0F0F0F0Full;
+    return digits * 10 + (digits >> 8);
+}
+
+inline int byteAt(std::uint64_t word, int i)
+{
+    return static_cast<int>((word >> (8 * i)) & 0xFF);
+}
+
+// Range checks of a decoded timestamp, no branches
+inline bool validFields(const Timestamp& t)
+{
+    static constexpr unsigned char kDays[16] = { 0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31, 0, 0, 0 };
+
+    unsigned leap = ((t.year % 4 == 0) & (t.year % 100 != 0)) | (t.year % 400 == 0);
+    unsigned days = kDays[t.month & 15] + ((t.month == 2) & leap);
+
+    return (static_cast<unsigned>(t.year) <= 9999) &
+           (static_cast<unsigned>(t.month - 1) < 12) &
+           (static_cast<unsigned>(t.day - 1) < days) &
+           (static_cast<unsigned>(t.hour) < 24) &
+           (static_cast<unsigned>(t.minute) < 60);
+}
+
+} // namespace timestamp_detail
+
+// "YYYY-MM-DD HH:MM" at p[0..15]: two 8-byte loads, layout and range
+// checks combined into one result. out is garbage when it returns false
+inline bool parseTimestampFixed(const char* p, Timestamp& out)
+{
+    using namespace timestamp_detail;
+
+    std::uint64_t date = loadWord(p);       // "YYYY-MM-"
+    std::uint64_t time = loadWord(p + 8);   // "DD HH:MM"
+
+    std::uint64_t mismatch = kDateLayout.mismatch(date) | kTimeLayout.mismatch(time);
+
+    std::uint64_t datePairs = pairValues(date);
+    std::uint64_t timePairs = pairValues(time);
+
+    out.year = byteAt(datePairs, 0) * 100 + byteAt(datePairs, 2);
+    out.month = byteAt(datePairs, 5);
+    out.day = byteAt(timePairs, 0);
+    out.hour = byteAt(timePairs, 3);
+    out.minute = byteAt(timePairs, 6);
+
+    return (mismatch == 0) & validFields(out);
+}
+
+// Everything else a sane feed writes: surrounding spaces, one-digit
+// month, day or hour, several spaces or a 'T' between date and time,
+// trailing ":SS" seconds. The calendar is validated the same way
+bool parseTimestampSlow(std::string_view text, Timestamp& out);
+
+// Returns false for anything that isn't a real date and time
+inline bool parseTimestamp(std::string_view text, Timestamp& out)
+{
+    if (text.size() == 16 && parseTimestampFixed(text.data(), out))
+        return true;
+    return parseTimestampSlow(text, out);
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date, negative before it
+// Integer-only era arithmetic (H. Hinnant's days_from_civil), no
+// mktime, time zones or locale
+inline std::int64_t daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    const unsigned dayOfYear = (153 * static_cast<unsigned>(month > 2 ? month - 3 : month + 9) + 2) / 5 +
+                               static_cast<unsigned>(day) - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return std::int64_t(era) * 146097 + dayOfEra - 719468;
+}
+
+// Minutes since 1970-01-01 00:00, the timestamp read as UTC
+inline std::int64_t epochMinutes(const Timestamp& t)
+{
+    return daysFromCivil(t.year, t.month, t.day) * 1440 + t.hour * 60 + t.minute;
+}
+
+// Inverse of epochMinutes
+Timestamp fromEpochMinutes(std::int64_t minutes);
+
+// "YYYY-MM-DD" of a day number, "YYYY-MM-DD HH:MM" of a minute number
+std::string formatDay(std::int64_t day);
+std::string formatMinute(std::int64_t minutes);
+
+// Hour of a valid timestamp, -1 for anything else
+inline int parseHour(std::string_view text)
+{
+    Timestamp t;
+    return parseTimestamp(text, t) ? t.hour : -1;
+}
@@ -0,0 +1,53 @@
+#pragma once // prevents multiple inclusions
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Bounded selection of the k best items from a stream
+//
+// better(a, b) is true when a ranks ahead of b. The heap is ordered so
+// its front is the worst item kept, a newcomer only has to beat that one.
+// Memory is O(min(k, items offered)), so a huge k costs nothing up front,
+// and the items are meant to be cheap handles (ids) into the aggregate store.
+template <class T, class Better>
+class TopK {
+public:
+    TopK(std::size_t k, Better better)
+        : limit(k), better(better)
+    {
+    }
+
+    // O(log k) when the item makes the cut, O(1) otherwise
+    void offer(const T& item)
+    {
+        if (heap.size() < limit)
+        {
+            heap.push_back(item);
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+        else if (limit > 0 && better(item, heap.front()))
+        {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = item;
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    }
+
+    // Best first, leaves the selector empty
+    std::vector<T> take()
+    {
+        std::sort_heap(heap.begin(), heap.end(), better);
+        return std::move(heap);
+    }
+
+private:
+    std::size_t limit;
+    Better better;
+    std::vector<T> heap;
+};
+
+template <class T, class Better>
+TopK<T, Better> makeTopK(std::size_t k, Better better)
+{
+    return TopK<T, Better>(k, better);
+}
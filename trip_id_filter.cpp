@@ -0,0 +1,114 @@
+#include "trip_id_filter.h"
+#include <algorithm>
+
+using namespace std;
+
+bool TripIdFilter::parseTripId(string_view text, uint64_t& out)
+{
+    // 19 digits stay below 2^64 - 1, CountMap's empty key
+    if (text.empty() || text.size() > 19 || (text[0] == '0' && text.size() > 1))
+        return false;
+
+    uint64_t value = 0;
+    for (char c : text)
+    {
+        unsigned digit = static_cast<unsigned>(c - '0');
+        if (digit > 9)
+            return false;
+        value = value * 10 + digit;
+    }
+
+    out = value;
+    return true;
+}
+
+bool TripIdFilter::seenSuspect(uint64_t id)
+{
+    long long bit = 1LL << (id & 7);
+    if (pendingHas(id) || (exact.size() != 0 && (exact.get(id >> 3) & bit)))
+    {
+        repeats++;
+        return true;
+    }
+
+    // Bits set by other ids, this one is new after all
+    numericIds++;
+    misses++;
+    if (pending.empty() || id > pending.back())
+    {
+        pending.push_back(id);
+        return false;
+    }
+
+    // The masks only ever gain bits they lack, so add() acts as an OR
+    exact.add(id >> 3, bit);
+    return false;
+}
+
+bool TripIdFilter::pendingHas(uint64_t id)
+{
+    if (pending.empty() || id > pending.back() || id < pending.front())
+        return false;
+
+    // A replayed batch repeats the ids in their order
+    size_t next = lastHit + 1;
+    if (next < pending.size() && pending[next] == id)
+    {
+        lastHit = next;
+        return true;
+    }
+
+    auto it = lower_bound(pending.begin(), pending.end(), id);
+    if (it == pending.end() || *it != id)
+        return false;
+
+    lastHit = static_cast<size_t>(it - pending.begin());
+    return true;
+}
+
+void TripIdFilter::settle()
+{
+    for (uint64_t id : pending)
+        exact.add(id >> 3, 1LL << (id & 7));
+    pending.clear();
+    lastHit = 0;
+}
+
+bool TripIdFilter::seenText(string_view tripId)
+{
+    size_t before = names.size();
+    names.intern(tripId);
+    if (names.size() != before)
+        return false;
+
+    repeats++;
+    return true;
+}
+
+void TripIdFilter::reserve(size_t count)
+{
+    if (count > pending.capacity())
+        pending.reserve(count);
+
+    resize(count);
+}
+
+void TripIdFilter::resize(size_t count)
+{
+    size_t wanted = max<size_t>(64, blocks.size());
+    while (wanted * kIdsPerBlock < count)
+        wanted *= 2;
+
+    if (wanted == blocks.size())
+        return;
+
+    // Every id is either pending or in the exact set
+    blocks.assign(wanted, Block{});
+    for (uint64_t id : pending)
+        testAndSet(id);
+    exact.forEach([this](uint64_t group, long long mask) {
+        for (uint64_t i = 0; i < 8; ++i)
+            if (mask & (1LL << i))
+                testAndSet(group << 3 | i);
+    });
+}
@@ -0,0 +1,120 @@
+#pragma once // prevents multiple inclusions
+#include "count_map.h"
+#include "zone_dictionary.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Remembers every TripID it is shown and reports the repeats, for
+// dropping replayed rows before they are counted
+//
+// Numeric ids (up to 19 digits, no leading zero) are checked against a
+// blocked Bloom filter first: each id sets 8 bits inside one 64-byte
+// block, so a check touches a single cache line, and the 8 ids of a
+// group (id / 8) share a block so a feed numbered in order stays on the
+// same line. A new id only sets its bits and is appended to a pending
+// list, kept in ascending order. Only when all 8 bits are already set
+// (a repeat, or a false positive) is the id looked up exactly: a binary
+// search of the pending list, starting next to the last repeat so a
+// replayed batch costs O(1) a row, and the exact set. An id that would
+// break the pending order first moves the list into the exact set,
+// which holds one 8-bit mask per group, so ids in order fill it a slot
+// at a time too. A feed numbered in order never builds the exact set.
+//
+// Any other id is interned in a ZoneDictionary, exact but slower
+class TripIdFilter {
+public:
+    // Records tripId, returns true if it was recorded before
+    bool seen(std::string_view tripId)
+    {
+        std::uint64_t id;
+        if (!parseTripId(tripId, id))
+            return seenText(tripId);
+
+        if (numericIds >= blocks.size() * kIdsPerBlock)
+            grow();
+
+        if (testAndSet(id))
+            return seenSuspect(id);
+
+        if (!pending.empty() && id < pending.back())
+            settle();
+
+        pending.push_back(id);
+        numericIds++;
+        return false;
+    }
+
+    // The value of an id made of 1 to 19 digits without a leading zero,
+    // so two ids get the same value only if they are the same text
+    static bool parseTripId(std::string_view text, std::uint64_t& out);
+
+    // seen() calls that returned true
+    long long duplicates() const { return repeats; }
+
+    // Suspected repeats that the exact lookup turned down
+    long long falsePositives() const { return misses; }
+
+    // Distinct ids recorded
+    std::size_t size() const { return numericIds + names.size(); }
+
+    // Sizes the filter and the pending list for count numeric ids, so
+    // neither is rebuilt on the way there. The list only takes address
+    // space until ids arrive
+    void reserve(std::size_t count);
+
+private:
+    // 512 bits per block, about 16 per id at the most before it grows
+    static constexpr std::size_t kIdsPerBlock = 32;
+
+    struct alignas(64) Block {
+        std::uint64_t words[8];
+    };
+
+    // Sets the id's 8 bits in its group's block, true if all of them
+    // were set already
+    bool testAndSet(std::uint64_t id)
+    {
+        // Odd multipliers from Impala/Parquet's split block Bloom filter
+        static constexpr std::uint32_t kSalt[8] = { 0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U };
+
+        Block& block = blocks[CountMap::hashKey(id >> 3) & (blocks.size() - 1)];
+        std::uint32_t low = static_cast<std::uint32_t>(CountMap::hashKey(id));
+
+        std::uint64_t missing = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            std::uint64_t bit = std::uint64_t(1) << ((low * kSalt[i]) >> 26);
+            missing |= ~block.words[i] & bit;
+            block.words[i] |= bit;
+        }
+        return missing == 0;
+    }
+
+    bool seenSuspect(std::uint64_t id);
+    bool seenText(std::string_view tripId);
+
+    // Moves the pending ids into the exact set
+    void settle();
+
+    // Binary search of the pending list, trying the slot after the last
+    // hit first
+    bool pendingHas(std::uint64_t id);
+
+    // Rebuilds the filter with room for count numeric ids
+    void resize(std::size_t count);
+
+    // Doubles the block count
+    void grow() { resize(numericIds + 1); }
+
+    std::vector<Block> blocks;
+    std::vector<std::uint64_t> pending;   // ascending ids not in the exact set
+    std::size_t lastHit = 0;              // pending index of the last repeat
+    CountMap exact;                       // id / 8 -> bit id % 8 of each id in it
+    ZoneDictionary names;                 // ids that aren't numeric
+    std::size_t numericIds = 0;
+    long long repeats = 0;
+    long long misses = 0;
+};
@@ -0,0 +1,107 @@
+#include "work_pool.h"
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+using namespace std;
+
+WorkStealingPool::WorkStealingPool(unsigned workers)
+{
+    workers = max(1u, workers);
+    queues.reserve(workers);
+    for (unsigned i = 0; i < workers; i++)
+        queues.push_back(make_unique<Queue>());
+}
+
+void WorkStealingPool::push(Task task)
+{
+    spawn(nextQueue, move(task));
+    nextQueue = (nextQueue + 1) % size();
+}
+
+void WorkStealingPool::spawn(unsigned worker, Task task)
+{
+    pending++;
+    {
+        Queue& q = *queues[worker];
+        lock_guard<mutex> guard(q.lock);
+        q.tasks.push_back(move(task));
+    }
+    queued++;
+
+    // Taking idleLock orders this against a worker about to sleep
+    {
+        lock_guard<mutex> guard(idleLock);
+    }
+    idle.notify_one();
+}
+
+bool WorkStealingPool::take(unsigned worker, Task& task)
+{
+    // Own deque from the back: the most recently split piece is still warm
+    {
+        Queue& own = *queues[worker];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    // Others from the front: the oldest task is usually the largest
+    unsigned n = size();
+    for (unsigned i = 1; i < n; i++)
+    {
+        Queue& victim = *queues[(worker + i) % n];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::work(unsigned worker)
+{
+    Task task;
+    for (;;)
+    {
+        if (take(worker, task))
+        {
+            task(worker);
+            task = nullptr;
+
+            if (--pending == 0)
+            {
+                lock_guard<mutex> guard(idleLock);
+                idle.notify_all();
+            }
+            continue;
+        }
+
+        unique_lock<mutex> guard(idleLock);
+        idle.wait(guard, [this] { return queued > 0 || pending == 0; });
+        if (pending == 0)
+            return;
+    }
+}
+
+void WorkStealingPool::run()
+{
+    vector<thread> helpers;
+    helpers.reserve(size() - 1);
+    for (unsigned i = 1; i < size(); i++)
+        helpers.emplace_back(&WorkStealingPool::work, this, i);
+
+    work(0);
+
+    for (thread& t : helpers)
+        t.join();
+}
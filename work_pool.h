@@ -0,0 +1,56 @@
+#pragma once // prevents multiple inclusions
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fixed set of workers, one task deque each
+// A worker runs its own newest task first and, when its deque is empty,
+// steals the oldest task of another worker. Tasks may queue more tasks,
+// so a big job can split itself and let idle workers take the pieces.
+class WorkStealingPool {
+public:
+    // Receives the index of the worker running it, 0 .. workers-1
+    using Task = std::function<void(unsigned worker)>;
+
+    explicit WorkStealingPool(unsigned workers);
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+    // Queues a task before run(), spread round-robin over the workers
+    void push(Task task);
+
+    // Queues a task from inside a running task, on the caller's own deque
+    void spawn(unsigned worker, Task task);
+
+    // Returns once every task, spawned ones included, has finished
+    // The calling thread works as worker 0
+    void run();
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    bool take(unsigned worker, Task& task);
+    void work(unsigned worker);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    unsigned nextQueue = 0;
+
+    // Tasks queued or running, and tasks sitting in a deque
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> queued{0};
+
+    // Idle workers sleep here until something is queued or all is done
+    std::mutex idleLock;
+    std::condition_variable idle;
+};
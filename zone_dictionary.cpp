@@ -0,0 +1,206 @@
+#include "zone_dictionary.h"
+#include "bit_ops.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Bit i set when ctrl[i] == value, over one group of 16 control bytes
+inline uint32_t matchByte(const uint8_t* group, uint8_t value)
+{
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    __m128i hits = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(value)));
+    return static_cast<uint32_t>(_mm_movemask_epi8(hits));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; ++i)
+        mask |= uint32_t(group[i] == value) << i;
+    return mask;
+#endif
+}
+
+inline uint64_t load64(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Reads the last n < 8 bytes without a memcpy call
+inline uint64_t loadTail(const char* p, size_t n)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; ++i)
+        v |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+// Equal length keys, compared eight bytes at a time
+inline bool sameBytes(const char* a, const char* b, size_t n)
+{
+    while (n >= 8)
+    {
+        if (load64(a) != load64(b))
+            return false;
+        a += 8;
+        b += 8;
+        n -= 8;
+    }
+    return loadTail(a, n) == loadTail(b, n);
+}
+
+// splitmix64 finalizer
+inline uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace
+
+uint64_t ZoneDictionary::hashKey(string_view key)
+{
+    // Eight bytes per step, zone ids are short so this is 1-3 steps
+    const char* p = key.data();
+    size_t n = key.size();
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+
+    while (n >= 8)
+    {
+        h = mix(h ^ load64(p));
+        p += 8;
+        n -= 8;
+    }
+
+    return mix(h ^ loadTail(p, n));
+}
+
+bool ZoneDictionary::slotMatches(const Slot& slot, string_view zone) const
+{
+    if (slot.length != kLongKey)
+        return slot.length == zone.size() &&
+               sameBytes(slot.key, zone.data(), zone.size());
+
+    // Long keys are rare, compare against the stored name
+    return names[slot.id] == zone;
+}
+
+size_t ZoneDictionary::probe(string_view zone, uint64_t hash, bool& found) const
+{
+    size_t groupMask = ctrl.size() / kGroupWidth - 1;
+    size_t group = (hash >> 7) & groupMask;
+    uint8_t tag = static_cast<uint8_t>(hash & 0x7F);
+
+    // Triangular probing over groups visits every group once
+    for (size_t step = 1;; ++step)
+    {
+        const uint8_t* base = &ctrl[group * kGroupWidth];
+
+        for (uint32_t hits = matchByte(base, tag); hits; hits &= hits - 1)
+        {
+            size_t index = group * kGroupWidth + ctz32(hits);
+            if (slotMatches(slots[index], zone))
+            {
+                found = true;
+                return index;
+            }
+        }
+
+        // Nothing is ever erased, so an empty slot ends the probe sequence
+        uint32_t empty = matchByte(base, kEmpty);
+        if (empty)
+        {
+            found = false;
+            return group * kGroupWidth + ctz32(empty);
+        }
+
+        group = (group + step) & groupMask;
+    }
+}
+
+void ZoneDictionary::place(size_t index, uint64_t hash, uint32_t id)
+{
+    ctrl[index] = static_cast<uint8_t>(hash & 0x7F);
+
+    Slot& slot = slots[index];
+    slot.id = id;
+
+    const string& key = names[id];
+    if (key.size() <= kInlineKey)
+    {
+        slot.length = static_cast<uint8_t>(key.size());
+        memcpy(slot.key, key.data(), key.size());
+    }
+    else
+    {
+        slot.length = kLongKey;
+    }
+}
+
+void ZoneDictionary::rehash(size_t capacity)
+{
+    ctrl.assign(capacity, kEmpty);
+    slots.assign(capacity, Slot{});
+
+    for (uint32_t id = 0; id < names.size(); ++id)
+    {
+        uint64_t hash = hashKey(names[id]);
+        bool found;
+        place(probe(names[id], hash, found), hash, id);
+    }
+}
+
+void ZoneDictionary::reserve(size_t count)
+{
+    // Keep the load factor at or below 7/8
+    size_t needed = count + count / 7 + 1;
+    size_t capacity = kGroupWidth;
+    while (capacity < needed)
+        capacity *= 2;
+
+    if (capacity > ctrl.size())
+        rehash(capacity);
+}
+
+uint32_t ZoneDictionary::intern(string_view zone)
+{
+    if (ctrl.empty())
+        rehash(kGroupWidth);
+
+    uint64_t hash = hashKey(zone);
+    bool found;
+    size_t index = probe(zone, hash, found);
+    if (found)
+        return slots[index].id;
+
+    if (names.size() + 1 > ctrl.size() - ctrl.size() / 8)
+    {
+        rehash(ctrl.size() * 2);
+        index = probe(zone, hash, found);
+    }
+
+    uint32_t id = static_cast<uint32_t>(names.size());
+    names.emplace_back(zone);
+    place(index, hash, id);
+    return id;
+}
+
+uint32_t ZoneDictionary::find(string_view zone) const
+{
+    if (ctrl.empty())
+        return npos;
+
+    bool found;
+    size_t index = probe(zone, hashKey(zone), found);
+    return found ? slots[index].id : npos;
+}
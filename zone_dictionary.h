@@ -0,0 +1,70 @@
+#pragma once // prevents multiple inclusions
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interns PickupZoneIDs into dense ids (0, 1, 2, ...)
+// Each distinct zone string is stored exactly once,
+// aggregates elsewhere are plain arrays indexed by the id
+//
+// Lookups go through an open-addressing table in the Swiss-table style:
+// one control byte per slot holding 7 bits of the hash, scanned 16 at a
+// time (SSE2 when available), and keys up to 27 bytes stored inline in
+// the slot so a hit never leaves the table's own memory
+class ZoneDictionary {
+public:
+    static constexpr std::uint32_t npos = UINT32_MAX;
+
+    // Returns the id of zone, assigning the next free id if it is new
+    std::uint32_t intern(std::string_view zone);
+
+    // Returns the id of zone or npos, never inserts
+    std::uint32_t find(std::string_view zone) const;
+
+    const std::string& name(std::uint32_t id) const { return names[id]; }
+
+    std::size_t size() const { return names.size(); }
+
+    // Sizes the table so count zones fit without rehashing
+    void reserve(std::size_t count);
+
+    // The table's hash of a zone string, also used by SpaceSaving
+    static std::uint64_t hashKey(std::string_view key);
+
+private:
+    static constexpr std::size_t kGroupWidth = 16;
+    static constexpr std::size_t kInlineKey = 27;
+
+    // Control byte values, a full slot stores the low 7 hash bits
+    static constexpr std::uint8_t kEmpty = 0x80;
+
+    // Slot length marker for keys that only live in names
+    static constexpr std::uint8_t kLongKey = 0xFF;
+
+    // 32 bytes, two slots per cache line
+    struct Slot {
+        std::uint32_t id;
+        std::uint8_t length;
+        char key[kInlineKey];
+    };
+
+    // Slot index holding zone, or the empty slot where it would go
+    // Sets found accordingly, the table must have at least one group
+    std::size_t probe(std::string_view zone, std::uint64_t hash, bool& found) const;
+
+    bool slotMatches(const Slot& slot, std::string_view zone) const;
+
+    void place(std::size_t index, std::uint64_t hash, std::uint32_t id);
+
+    void rehash(std::size_t capacity);
+
+    // deque never relocates elements, so name() references stay valid
+    std::deque<std::string> names;
+
+    // capacity is a power of two and a multiple of kGroupWidth
+    std::vector<std::uint8_t> ctrl;
+    std::vector<Slot> slots;
+};
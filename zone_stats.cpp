@@ -0,0 +1,182 @@
+#include "zone_stats.h"
+
+using namespace std;
+
+uint32_t ZoneStatsTable::slot(string_view zone)
+{
+    uint32_t id = dict.intern(zone);
+    if (id == records.size())
+        records.emplace_back();
+
+    return id;
+}
+
+uint32_t ZoneStatsTable::add(string_view zone, int hour)
+{
+    uint32_t id = slot(zone);
+    ZoneStats& s = records[id];
+    s.total++;
+    s.hours[hour]++;
+    return id;
+}
+
+void ZoneStatsTable::addStats(string_view zone, const ZoneStats& stats)
+{
+    ZoneStats& to = records[slot(zone)];
+
+    to.total += stats.total;
+    for (int h = 0; h < 24; ++h)
+        to.hours[h] += stats.hours[h];
+}
+
+void ZoneStatsTable::enable(const TableFeatures& features)
+{
+    feats.days = feats.days || features.days;
+    feats.minutes = feats.minutes || features.minutes;
+    feats.amounts = feats.amounts || features.amounts;
+    feats.routes = feats.routes || features.routes;
+    feats.weekdays = feats.weekdays || features.weekdays;
+    feats.quarterHours = feats.quarterHours || features.quarterHours;
+    feats.fiveMinutes = feats.fiveMinutes || features.fiveMinutes;
+
+    if (feats.heavyHitters == 0 && features.heavyHitters != 0)
+    {
+        feats.heavyHitters = features.heavyHitters;
+        zoneHits = SpaceSaving(feats.heavyHitters);
+        slotHits = SpaceSaving(feats.heavyHitters);
+    }
+
+    if (slotSketch.empty() && features.sketchWidth != 0 && features.sketchDepth != 0)
+    {
+        feats.sketchWidth = features.sketchWidth;
+        feats.sketchDepth = features.sketchDepth;
+        slotSketch = CountMinSketch(feats.sketchWidth, feats.sketchDepth);
+
+        // Rows loaded or merged before the sketch existed
+        sketchRecords(*this);
+    }
+}
+
+void ZoneStatsTable::sketchRecords(const ZoneStatsTable& from)
+{
+    for (uint32_t id = 0; id < from.size(); ++id)
+        for (int h = 0; h < 24; ++h)
+            if (from.records[id].hours[h] != 0)
+                slotSketch.add(slotHash(from.dict.name(id), h), from.records[id].hours[h]);
+}
+
+void ZoneStatsTable::addTime(uint32_t zone, int64_t minute)
+{
+    // Floor division keeps minutes before 1970 in their own day
+    int64_t day = minute >= 0 ? minute / 1440 : -((-minute + 1439) / 1440);
+
+    if (feats.days)
+    {
+        if (zone >= dayCounts.size())
+            dayCounts.resize(records.size());
+        dayCounts[zone].add(day);
+    }
+
+    if (feats.weekdays)
+    {
+        if (zone >= weekCounts.size())
+            weekCounts.resize(records.size(), WeekHours{});
+
+        // 1970-01-01 was a Thursday, weekday 3 counting from Monday
+        int64_t weekday = (day + 3) % 7;
+        if (weekday < 0)
+            weekday += 7;
+        int hour = static_cast<int>(minute - day * 1440) / 60;
+        weekCounts[zone][static_cast<size_t>(weekday * 24 + hour)]++;
+    }
+
+    int minuteOfDay = static_cast<int>(minute - day * 1440);
+    if (feats.quarterHours)
+        addSlot<QuarterHourSlots>(quarterCounts, records.size(), zone, minuteOfDay);
+    if (feats.fiveMinutes)
+        addSlot<FiveMinuteSlots>(fiveMinuteCounts, records.size(), zone, minuteOfDay);
+
+    if (feats.minutes)
+        minuteCounts.add(minute);
+}
+
+template <class Counts>
+void ZoneStatsTable::mergeSlots(vector<Counts>& to, const vector<Counts>& from,
+                                const vector<uint32_t>& ids)
+{
+    if (!from.empty() && to.size() < records.size())
+        to.resize(records.size(), Counts{});
+
+    for (uint32_t src = 0; src < from.size(); ++src)
+        for (size_t i = 0; i < from[src].size(); ++i)
+            to[ids[src]][i] += from[src][i];
+}
+
+void ZoneStatsTable::merge(const ZoneStatsTable& other)
+{
+    // Self merge would walk the maps it is growing
+    if (&other == this)
+    {
+        ZoneStatsTable copy = other;
+        merge(copy);
+        return;
+    }
+
+    // Before the records arrive, so a sketch created here only covers
+    // this table's own rows
+    enable(other.feats);
+
+    // Zone ids differ between tables, remember where each one went
+    vector<uint32_t> ids(other.size());
+    for (uint32_t src = 0; src < other.size(); ++src)
+    {
+        ids[src] = slot(other.dict.name(src));
+        ZoneStats& to = records[ids[src]];
+        const ZoneStats& from = other.records[src];
+
+        to.total += from.total;
+        for (int h = 0; h < 24; ++h)
+            to.hours[h] += from.hours[h];
+    }
+
+    if (!other.dayCounts.empty() && dayCounts.size() < records.size())
+        dayCounts.resize(records.size());
+
+    for (uint32_t src = 0; src < other.dayCounts.size(); ++src)
+        dayCounts[ids[src]].merge(other.dayCounts[src]);
+
+    minuteCounts.merge(other.minuteCounts);
+
+    mergeSlots(weekCounts, other.weekCounts, ids);
+    mergeSlots(quarterCounts, other.quarterCounts, ids);
+    mergeSlots(fiveMinuteCounts, other.fiveMinuteCounts, ids);
+
+    if (!other.amountCounts.empty() && amountCounts.size() < records.size())
+        amountCounts.resize(records.size());
+
+    for (uint32_t src = 0; src < other.amountCounts.size(); ++src)
+        amountCounts[ids[src]].merge(other.amountCounts[src]);
+
+    rejected += other.rejected;
+
+    zoneHits.merge(other.zoneHits);
+    slotHits.merge(other.slotHits);
+
+    // Snapshots and sketches of other dimensions bring records only
+    if (sketches() && (other.slotSketch.empty() || !slotSketch.merge(other.slotSketch)))
+        sketchRecords(other);
+
+    if (other.routeCounts.size() == 0)
+        return;
+
+    vector<uint32_t> dropoffIds(other.dropoffDict.size());
+    for (uint32_t src = 0; src < other.dropoffDict.size(); ++src)
+        dropoffIds[src] = dropoffDict.intern(other.dropoffDict.name(src));
+
+    routeCounts.reserve(routeCounts.size() + other.routeCounts.size());
+    other.routeCounts.forEach([&](uint64_t key, long long count) {
+        uint32_t origin = static_cast<uint32_t>(key >> 32);
+        uint32_t dropoff = static_cast<uint32_t>(key);
+        routeCounts.add(routeKey(ids[origin], dropoffIds[dropoff]), count);
+    });
+}
@@ -0,0 +1,353 @@
+#pragma once // prevents multiple inclusions
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "count_map.h"
+#include "count_min.h"
+#include "space_saving.h"
+#include "zone_dictionary.h"
+
+// Time-of-day bucket width as a type, so each granularity gets its own
+// fixed-size counter arrays and loops with compile-time bounds
+template <int MinutesPerSlot>
+struct SlotGranularity {
+    static_assert(1440 % MinutesPerSlot == 0, "slots must tile the day");
+
+    static constexpr int kMinutes = MinutesPerSlot;
+    static constexpr int kSlots = 1440 / MinutesPerSlot;
+
+    static constexpr int slotOf(int minuteOfDay) { return minuteOfDay / MinutesPerSlot; }
+};
+
+using HourSlots = SlotGranularity<60>;          // 24, ZoneStats::hours
+using QuarterHourSlots = SlotGranularity<15>;   // 96
+using FiveMinuteSlots = SlotGranularity<5>;     // 288
+
+// Counters of one zone at one granularity, index slotOf(minute of day)
+template <class Granularity>
+using SlotArray = std::array<long long, Granularity::kSlots>;
+
+// Sum, minimum and maximum of one fixed-point field (see decimal.h)
+// min and max mean nothing while the owning count is 0
+struct AmountStats {
+    long long sum = 0;
+    long long min = LLONG_MAX;
+    long long max = 0;
+
+    void add(long long value)
+    {
+        sum += value;
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+    }
+
+    void merge(const AmountStats& other)
+    {
+        sum += other.sum;
+        min = other.min < min ? other.min : min;
+        max = other.max > max ? other.max : max;
+    }
+};
+
+// DistanceKm and FareAmount of the trips with both fields well formed
+struct TripAmounts {
+    long long trips = 0;
+    AmountStats distance;
+    AmountStats fare;
+
+    void add(long long km, long long amount)
+    {
+        trips++;
+        distance.add(km);
+        fare.add(amount);
+    }
+
+    void merge(const TripAmounts& other)
+    {
+        trips += other.trips;
+        distance.merge(other.distance);
+        fare.merge(other.fare);
+    }
+};
+
+// Amounts of one zone, for the whole day and per hour
+struct ZoneAmounts {
+    TripAmounts all;
+    std::array<TripAmounts, 24> hours;
+
+    void merge(const ZoneAmounts& other)
+    {
+        all.merge(other.all);
+        for (int h = 0; h < 24; ++h)
+            hours[h].merge(other.hours[h]);
+    }
+};
+
+// Everything aggregated for one pickup zone, in one contiguous slot
+// Hour counters are inline so a zone owns no heap memory
+struct ZoneStats {
+    long long total = 0;
+    SlotArray<HourSlots> hours{}; // index 0-23
+};
+
+// Aggregates kept on top of the zone/hour counts
+// All off by default, so the plain path pays nothing for them
+struct TableFeatures {
+    bool days = false;      // trips per (zone, calendar day)
+    bool minutes = false;   // trips per minute, all zones together
+    bool amounts = false;   // distance and fare per zone and (zone, hour)
+    bool routes = false;    // trips per (pickup zone, dropoff zone)
+    bool weekdays = false;  // trips per (zone, weekday, hour)
+    bool quarterHours = false;  // trips per (zone, 15-minute slot)
+    bool fiveMinutes = false;   // trips per (zone, 5-minute slot)
+
+    // Non-zero: Space-Saving summaries of this many zones and as many
+    // (zone, hour) slots replace the exact records, see addApprox()
+    std::size_t heavyHitters = 0;
+
+    // Non-zero: a Count-Min sketch of (zone, hour) with these dimensions,
+    // kept in either mode
+    std::size_t sketchWidth = 0;
+    std::size_t sketchDepth = 0;
+};
+
+// Weekday x hour counters of one zone, index weekday * 24 + hour,
+// weekday 0 is Monday
+using WeekHours = std::array<long long, 7 * 24>;
+
+// Aggregates for a set of rows, one ZoneStats per interned zone id
+//
+// The optional per-zone aggregates (amounts, weekdays, finer slots) are
+// side vectors under the same ids rather than record fields: each is
+// 0.75 to 2.25 KiB a zone, and inline they would drag that through the
+// cache on every row of the plain path, which only needs the 200 bytes
+// of a ZoneStats
+class ZoneStatsTable {
+public:
+    ZoneStatsTable() = default;
+    explicit ZoneStatsTable(const TableFeatures& features)
+        : feats(features), zoneHits(features.heavyHitters), slotHits(features.heavyHitters),
+          slotSketch(features.sketchWidth, features.sketchDepth)
+    {
+    }
+
+    // Counts one trip, a single hash lookup per call
+    // Returns the zone id for the optional aggregates below
+    std::uint32_t add(std::string_view zone, int hour);
+
+    // Turns on more aggregates, they only see rows added from now on
+    void enable(const TableFeatures& features);
+    const TableFeatures& features() const { return feats; }
+
+    // True if addTime() has anything to record
+    bool tracksTime() const
+    {
+        return feats.days || feats.minutes || feats.weekdays || feats.quarterHours || feats.fiveMinutes;
+    }
+
+    // Pickup time of a trip already counted by add(), in epoch minutes
+    void addTime(std::uint32_t zone, std::int64_t minute);
+
+    // Trips per day number (days since 1970-01-01) of one zone
+    // Empty for zones without rows since days were enabled
+    const DenseCounts& days(std::uint32_t zone) const
+    {
+        static const DenseCounts none;
+        return zone < dayCounts.size() ? dayCounts[zone] : none;
+    }
+
+    // Weekday x hour counters of one zone, all zero for zones without rows
+    // since weekdays were enabled
+    const WeekHours& weekHours(std::uint32_t zone) const
+    {
+        static const WeekHours none{};
+        return zone < weekCounts.size() ? weekCounts[zone] : none;
+    }
+
+    // Slot counters of one zone at a compile-time granularity
+    // HourSlots reads the record itself, the finer ones are all zero for
+    // zones without rows since they were enabled
+    template <class Granularity>
+    const SlotArray<Granularity>& slots(std::uint32_t zone) const
+    {
+        if constexpr (std::is_same_v<Granularity, HourSlots>)
+        {
+            return records[zone].hours;
+        }
+        else
+        {
+            static const SlotArray<Granularity> none{};
+            const auto& counts = slotVector<Granularity>();
+            return zone < counts.size() ? counts[zone] : none;
+        }
+    }
+
+    // Trips per minute number (minutes since 1970-01-01 00:00), all zones
+    const DenseCounts& minutes() const { return minuteCounts; }
+
+    // True if addAmounts() has anything to record
+    bool tracksAmounts() const { return feats.amounts; }
+
+    // Fixed-point distance and fare of a trip already counted by add()
+    void addAmounts(std::uint32_t zone, int hour, long long distance, long long fare)
+    {
+        if (zone >= amountCounts.size())
+            amountCounts.resize(records.size());
+
+        ZoneAmounts& a = amountCounts[zone];
+        a.all.add(distance, fare);
+        a.hours[hour].add(distance, fare);
+    }
+
+    // A counted trip whose distance or fare didn't parse
+    void rejectAmounts() { rejected++; }
+    long long rejectedAmounts() const { return rejected; }
+
+    // Amounts of one zone in one hour (0-23) or the whole day (-1),
+    // empty for zones without any
+    const TripAmounts& amounts(std::uint32_t zone, int hour) const
+    {
+        static const TripAmounts none;
+        if (zone >= amountCounts.size())
+            return none;
+        return hour < 0 ? amountCounts[zone].all : amountCounts[zone].hours[hour];
+    }
+
+    bool tracksRoutes() const { return feats.routes; }
+
+    // Dropoff zone of a trip from origin, already counted by add()
+    // Dropoff zones get ids of their own, so a zone nobody is picked up
+    // in never shows up in the pickup rankings
+    void addRoute(std::uint32_t origin, std::string_view dropoff)
+    {
+        routeCounts.add(routeKey(origin, dropoffDict.intern(dropoff)));
+    }
+
+    // Key: origin id << 32 | dropoff id, see dropoffs() for the names
+    const CountMap& routes() const { return routeCounts; }
+    const ZoneDictionary& dropoffs() const { return dropoffDict; }
+
+    static std::uint64_t routeKey(std::uint32_t origin, std::uint32_t dropoff)
+    {
+        return std::uint64_t(origin) << 32 | dropoff;
+    }
+
+    // Approximate mode: rows go to the two fixed-size summaries instead of
+    // the records, none of the other aggregates see them
+    bool approximate() const { return feats.heavyHitters != 0; }
+
+    void addApprox(std::string_view zone, int hour)
+    {
+        zoneHits.add(zone, -1);
+        slotHits.add(zone, hour);
+    }
+
+    // Zone tags are -1, slot tags the hour
+    const SpaceSaving& zoneSummary() const { return zoneHits; }
+    const SpaceSaving& slotSummary() const { return slotHits; }
+
+    bool sketches() const { return !slotSketch.empty(); }
+
+    void addSketch(std::string_view zone, int hour) { slotSketch.add(slotHash(zone, hour)); }
+
+    const CountMinSketch& sketch() const { return slotSketch; }
+
+    // Returns false if the dimensions differ from this table's sketch
+    bool mergeSketch(const CountMinSketch& other) { return slotSketch.merge(other); }
+
+    // Sketch key of a (zone, hour) slot
+    static std::uint64_t slotHash(std::string_view zone, int hour)
+    {
+        std::uint64_t h = ZoneDictionary::hashKey(zone) ^ (std::uint64_t(hour + 1) * 0x9E3779B97F4A7C15ull);
+        h *= 0xBF58476D1CE4E5B9ull;
+        return h ^ (h >> 31);
+    }
+
+    // No rows in either mode
+    bool empty() const { return records.empty() && zoneHits.total() == 0; }
+
+    // Adds a whole pre-aggregated record to zone
+    void addStats(std::string_view zone, const ZoneStats& stats);
+
+    // Folds other into this, costs O(distinct zones of other)
+    void merge(const ZoneStatsTable& other);
+
+    const ZoneDictionary& zones() const { return dict; }
+    const ZoneStats& stats(std::uint32_t id) const { return records[id]; }
+    std::size_t size() const { return records.size(); }
+
+    void reserve(std::size_t count)
+    {
+        dict.reserve(count);
+        records.reserve(count);
+    }
+
+private:
+    template <class Granularity>
+    const std::vector<SlotArray<Granularity>>& slotVector() const
+    {
+        if constexpr (std::is_same_v<Granularity, QuarterHourSlots>)
+            return quarterCounts;
+        else
+            return fiveMinuteCounts;
+    }
+
+    // One slot array per zone id, grown on first use
+    template <class Granularity>
+    static void addSlot(std::vector<SlotArray<Granularity>>& counts, std::size_t zones,
+                        std::uint32_t zone, int minuteOfDay)
+    {
+        if (zone >= counts.size())
+            counts.resize(zones, SlotArray<Granularity>{});
+        counts[zone][Granularity::slotOf(minuteOfDay)]++;
+    }
+
+    // Adds the hour counts of from's records to the sketch, for rows that
+    // arrived without one (snapshots, tables built before it existed)
+    void sketchRecords(const ZoneStatsTable& from);
+
+    // Adds per-zone counter arrays of another table, ids maps its zone ids
+    template <class Counts>
+    void mergeSlots(std::vector<Counts>& to, const std::vector<Counts>& from,
+                    const std::vector<std::uint32_t>& ids);
+
+    // Returns the id of zone, creating an empty record if it is new
+    std::uint32_t slot(std::string_view zone);
+
+    ZoneDictionary dict;
+
+    // Key: zone id
+    std::vector<ZoneStats> records;
+
+    TableFeatures feats;
+
+    // Key: zone id, a zone's trips rarely span more than a few years
+    std::vector<DenseCounts> dayCounts;
+
+    // About four years of minutes in the array, 16 MiB at most
+    DenseCounts minuteCounts{ std::size_t(1) << 21 };
+
+    // Key: zone id, 1.3 KiB a zone
+    std::vector<WeekHours> weekCounts;
+
+    // Key: zone id, 0.75 and 2.25 KiB a zone
+    std::vector<SlotArray<QuarterHourSlots>> quarterCounts;
+    std::vector<SlotArray<FiveMinuteSlots>> fiveMinuteCounts;
+
+    // Key: zone id, 1.3 KiB a zone
+    std::vector<ZoneAmounts> amountCounts;
+    long long rejected = 0;
+
+    SpaceSaving zoneHits;
+    SpaceSaving slotHits;
+
+    CountMinSketch slotSketch;
+
+    // Sparse origin-destination matrix, one entry per route seen
+    ZoneDictionary dropoffDict;
+    CountMap routeCounts;
+};